@@ -4,10 +4,36 @@
 #include <string>
 #include <iostream>
 #include <ctime>
+#include <chrono>
 #include <cstring>
 #include <queue>
 #include <algorithm>
-#include "jsoncpp/json.h"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef ALPHATANK_THREADS
+#include <atomic>
+#include <mutex>
+#include <thread>
+#endif
+
+#ifdef ALPHATANK_NETWORK
+#include <cstdio>
+#include <cstdlib>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef ALPHATANK_PROFILE
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 using std::string;
 using std::cin;
@@ -17,9 +43,8 @@ using std::flush;
 using std::getline;
 using std::queue;
 
-clock_t startTime;
-int cnt = 0;
-string debug;
+// 用墙上时间计时：多线程时 clock() 是整个进程的 CPU 时间，会成倍地走快
+std::chrono::steady_clock::time_point startTime;
 
 namespace TankGame {
     using std::min;
@@ -41,7 +66,7 @@ namespace TankGame {
         Red = 1
     };
 
-    enum FieldItem {
+    enum FieldItem : unsigned char {
         None = 0,
         Brick = 1,
         Steel = 2,
@@ -53,6 +78,72 @@ namespace TankGame {
         Water = 128
     };
 
+#ifdef ALPHATANK_PROFILE
+    // 热点函数计时，编译时定义 ALPHATANK_PROFILE 开启，否则 PROFILE_SCOPE 为空
+    namespace Profiler {
+        enum Section {
+            Search, ParseInput, DoAction, Revert, InitDistance, CrossShoot, GetPattern, SectionCount
+        };
+
+        const char *const sectionNames[SectionCount] = {
+                "Search", "ParseInput", "DoAction", "Revert", "InitDistance", "CrossShoot", "GetPattern"
+        };
+
+#ifdef ALPHATANK_THREADS
+        std::atomic<unsigned long long> calls[SectionCount], ticks[SectionCount];
+#else
+        unsigned long long calls[SectionCount], ticks[SectionCount];
+#endif
+
+        inline unsigned long long Now() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+        }
+
+        // 作用域计时器，析构时把耗时累加到对应的 Section（嵌套时按包含时间计）
+        struct Scope {
+            const int section;
+            const unsigned long long begin;
+
+            explicit Scope(int section) : section(section), begin(Now()) {}
+
+            ~Scope() {
+                ticks[section] += Now() - begin;
+                ++calls[section];
+            }
+        };
+
+        // 程序开始时的时钟读数，用于把 tick 换算成微秒
+        struct Calibration {
+            const unsigned long long tick0 = Now();
+            const std::chrono::steady_clock::time_point time0 = std::chrono::steady_clock::now();
+
+            double TicksPerMicrosecond() const {
+                double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - time0).count();
+                return us > 0 ? (Now() - tick0) / us : 1;
+            }
+
+            // 退出（包括 exit(0)）时输出汇总
+            ~Calibration() {
+                double tpus = TicksPerMicrosecond();
+                fprintf(stderr, "%-14s%12s%14s%14s\n", "section", "calls", "total(us)", "avg(ns)");
+                for (int i = 0; i < SectionCount; ++i) {
+                    if (!calls[i])continue;
+                    fprintf(stderr, "%-14s%12llu%14.0f%14.1f\n", sectionNames[i], (unsigned long long) calls[i], ticks[i] / tpus,
+                            ticks[i] * 1000.0 / tpus / calls[i]);
+                }
+            }
+        } calibration;
+    }
+
+#define PROFILE_SCOPE(section) TankGame::Profiler::Scope profileScope(TankGame::Profiler::section)
+#else
+#define PROFILE_SCOPE(section)
+#endif
+
     template<class T>
     inline T sgn(T x) {
         if (x > 0)return 1;
@@ -73,15 +164,15 @@ namespace TankGame {
     inline T operator^(T a, T b) { return (T) ((int) a ^ (int) b); }
 
     template<typename T>
-    inline T &operator|=(T &a, T b) { return (T &) ((int &) a |= (int) b); }
+    inline T &operator|=(T &a, T b) { return a = (T) ((int) a | (int) b); }
 
     template<typename T>
-    inline T &operator&=(T &a, T b) { return (T &) ((int &) a &= (int) b); }
+    inline T &operator&=(T &a, T b) { return a = (T) ((int) a & (int) b); }
 
     template<typename T>
-    inline T &operator^=(T &a, T b) { return (T &) ((int &) a ^= (int) b); }
+    inline T &operator^=(T &a, T b) { return a = (T) ((int) a ^ (int) b); }
 
-    enum Action {
+    enum Action : signed char {
         Invalid = -2,
         Stay = -1,
         Up, Right, Down, Left,
@@ -106,7 +197,23 @@ namespace TankGame {
     // Tank（每方的坦克） - 0 为 0 号坦克，1 为 1 号坦克
     // Turn（回合编号） - 从 1 开始
 
-    const int fieldHeight = 9, fieldWidth = 9, sideCount = 2, tankPerSide = 2;
+    // 场地尺寸在编译期决定，默认是 Botzone 的 9x9；内部联赛的变体地图用 -DALPHATANK_FIELD_WIDTH 等宏编译
+    // 几何表（Geometry）和 Bitboard 的字数都由这里的常量在编译期推出，9x9 的构建不受影响
+#ifndef ALPHATANK_FIELD_WIDTH
+#define ALPHATANK_FIELD_WIDTH 9
+#endif
+#ifndef ALPHATANK_FIELD_HEIGHT
+#define ALPHATANK_FIELD_HEIGHT 9
+#endif
+#ifndef ALPHATANK_MAX_TURN
+#define ALPHATANK_MAX_TURN 100
+#endif
+    const int fieldHeight = ALPHATANK_FIELD_HEIGHT, fieldWidth = ALPHATANK_FIELD_WIDTH, sideCount = 2, tankPerSide = 2;
+
+    // 搜索按 (side, tank) 对 (!side, !tank) 配对，每方只能有两个坦克
+    static_assert(tankPerSide == 2, "搜索假定每方两个坦克");
+    static_assert(fieldWidth >= 5 && fieldWidth % 2 == 1, "基地在中间一列，坦克出生在基地两侧两格");
+    static_assert(fieldWidth <= 31, "第一回合的场地描述每个 int 至少装下一行");
 
     // 基地的横坐标
     const int baseX[sideCount] = {fieldWidth / 2, fieldWidth / 2};
@@ -114,13 +221,25 @@ namespace TankGame {
     // 基地的纵坐标
     const int baseY[sideCount] = {0, fieldHeight - 1};
 
+    // 中线所在行；高度为偶数时取靠红方的一行
+    const int midY = fieldHeight / 2;
+
+    // 己方半场的纵坐标范围是离 baseY 不超过 halfDepth - 1 格，9x9 时蓝方是 0..3、红方是 5..8
+    const int halfDepth = fieldHeight / 2;
+
     const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
     const FieldItem tankItemTypes[sideCount][tankPerSide] = {
             {Blue0, Blue1},
             {Red0,  Red1}
     };
 
-    int maxTurn = 100;
+    // 裁判在第 maxTurn 回合之后判平局；Bot 多留几回合余量，到 drawTurn 回合之后才判平局
+    // 按回合开的数组都开 drawTurn + 1 项
+    const int maxTurn = ALPHATANK_MAX_TURN, drawTurn = maxTurn + 5;
+    static_assert(drawTurn < 255, "currentTurn 是 unsigned char");
+
+    // 第一回合的场地描述：每个 int 表示连续 mapRowsPerWord 行的 01 矩阵，9x9 时是 3 个 int、每个 27 位
+    const int mapRowsPerWord = 31 / fieldWidth, mapWords = (fieldHeight + mapRowsPerWord - 1) / mapRowsPerWord;
 
     inline Action Forward(int side) {
         return side == Blue ? Down : Up;
@@ -134,6 +253,31 @@ namespace TankGame {
         return x >= UpShoot && x <= LeftShoot;
     }
 
+    // 动作在合法动作掩码中对应的位（第 act + 1 位，Stay 是第 0 位）
+    inline unsigned ActionBit(Action x) {
+        return 1u << (x + 1);
+    }
+
+    // 按给定顺序排列的合法动作，由动作顺序表和合法动作掩码生成
+    struct MoveList {
+        Action moves[9];
+        int count = 0;
+
+        MoveList(const Action order[9], unsigned legal) {
+            for (int i = 0; i < 9; i++)
+                if (legal & ActionBit(order[i]))
+                    moves[count++] = order[i];
+        }
+
+        const Action *begin() const {
+            return moves;
+        }
+
+        const Action *end() const {
+            return moves + count;
+        }
+    };
+
     inline bool ActionDirectionIsOpposite(Action a, Action b) {
         return a >= Up && b >= Up && (a + 2) % 4 == b % 4;
     }
@@ -142,6 +286,11 @@ namespace TankGame {
         return x >= 0 && x < fieldWidth && y >= 0 && y < fieldHeight;
     }
 
+    // 挡子弹的地形（砖、钢、基地），水和坦克不算
+    inline bool BlocksShot(FieldItem item) {
+        return item & (Brick | Steel | Base);
+    }
+
     inline bool canStand(FieldItem item) {
         const int mask = Brick | Steel | Base | Water;
         return !(item & mask);
@@ -169,6 +318,62 @@ namespace TankGame {
         return -1;
     }
 
+    // 棋盘几何的编译期表，场地尺寸是模板参数：格子编号 c = y * W + x 与坐标互换、四个方向的邻格、射线上的格子、
+    // 基地所在的行和列。搜索里的 BFS、DFS 和射线都直接遍历这些平铺的表，不再用 dx/dy 加 CoordValid
+    template<int W, int H>
+    struct Geometry {
+        static constexpr int cellCount = W * H, maxRay = (W > H ? W : H) - 1;
+
+        signed char x[cellCount] = {}, y[cellCount] = {};
+
+        // step[c][dir]：c 沿 dir 的邻格，出界为 -1
+        short step[cellCount][4] = {};
+
+        // neighbours[c] 的前 degree[c] 项是场内的邻格，按 dir 从小到大，neighbourDir 是对应的方向
+        short neighbours[cellCount][4] = {};
+        signed char neighbourDir[cellCount][4] = {}, degree[cellCount] = {};
+
+        // ray[c][dir][i]：从 c 沿 dir 的第 i + 1 格，共 rayLength[c][dir] 格
+        short ray[cellCount][4][maxRay] = {};
+        signed char rayLength[cellCount][4] = {};
+
+        // 双方基地所在行、所在列的格子
+        short baseRow[2][W] = {}, baseColumn[2][H] = {};
+
+        static constexpr int Cell(int cx, int cy) {
+            return cy * W + cx;
+        }
+
+        constexpr Geometry() {
+            const int ox[4] = {0, 1, 0, -1}, oy[4] = {-1, 0, 1, 0};
+            for (int c = 0; c < cellCount; ++c) {
+                x[c] = c % W;
+                y[c] = c / W;
+                for (int dir = 0; dir < 4; ++dir) {
+                    int k = 0;
+                    for (int nx = c % W + ox[dir], ny = c / W + oy[dir];
+                         nx >= 0 && nx < W && ny >= 0 && ny < H; nx += ox[dir], ny += oy[dir])
+                        ray[c][dir][k++] = Cell(nx, ny);
+                    rayLength[c][dir] = k;
+                    step[c][dir] = k ? ray[c][dir][0] : -1;
+                    if (k) {
+                        neighbours[c][degree[c]] = step[c][dir];
+                        neighbourDir[c][degree[c]++] = dir;
+                    }
+                }
+            }
+            for (int side = 0; side < 2; ++side) {
+                for (int i = 0; i < W; ++i)
+                    baseRow[side][i] = Cell(i, side ? H - 1 : 0);
+                for (int i = 0; i < H; ++i)
+                    baseColumn[side][i] = Cell(W / 2, i);
+            }
+        }
+    };
+
+    constexpr Geometry<fieldWidth, fieldHeight> geometry;
+    const int cellCount = geometry.cellCount;
+
     // 物件消失的记录，用于回退
     struct DisappearLog {
         FieldItem item;
@@ -188,45 +393,255 @@ namespace TankGame {
         }
     };
 
+    // 随机数键值，用于对局面的一部分做增量哈希
+    namespace Zobrist {
+        unsigned long long SplitMix(unsigned long long &x) {
+            unsigned long long z = (x += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // terrain[y][x]：该格子上的砖块或基地（可被打掉的障碍）
+        // cell[y][x]：BFS 的起点
+        unsigned long long terrain[fieldHeight][fieldWidth], cell[fieldHeight][fieldWidth];
+
+        // tank[side][tank][y][x]：存活坦克的位置；justShot[side][tank]：上回合射击过（本回合不能射击）
+        unsigned long long tank[sideCount][tankPerSide][fieldHeight][fieldWidth], justShot[sideCount][tankPerSide];
+
+        struct Initializer {
+            Initializer() {
+                unsigned long long seed = 20190325;
+                for (int y = 0; y < fieldHeight; ++y)
+                    for (int x = 0; x < fieldWidth; ++x) {
+                        terrain[y][x] = SplitMix(seed);
+                        cell[y][x] = SplitMix(seed);
+                    }
+                for (int side = 0; side < sideCount; ++side)
+                    for (int id = 0; id < tankPerSide; ++id) {
+                        for (int y = 0; y < fieldHeight; ++y)
+                            for (int x = 0; x < fieldWidth; ++x)
+                                tank[side][id][y][x] = SplitMix(seed);
+                        justShot[side][id] = SplitMix(seed);
+                    }
+            }
+        } initializer;
+    }
+
+    // 180° 旋转对称：裁判生成的地图中心对称，局面旋转 180° 再交换双方得到的孪生局面与原局面等价
+    // 只跟地形有关的缓存用两个方向里地形哈希较小的那个作键，蓝方和红方的查询落到同一条记录上
+    namespace Symmetry {
+        inline int RotateX(int x) {
+            return fieldWidth - 1 - x;
+        }
+
+        inline int RotateY(int y) {
+            return fieldHeight - 1 - y;
+        }
+
+        // 是否换到旋转后的方向：mirror 是旋转后地形的哈希；地形本身对称时两个方向哈希相同，由 tie 决定
+        inline bool Rotated(unsigned long long terrain, unsigned long long mirror, bool tie) {
+            return mirror < terrain || (mirror == terrain && tie);
+        }
+
+        // 旋转后格子编号较小的方向为规范方向
+        inline bool CellTie(int x, int y) {
+            return RotateY(y) * fieldWidth + RotateX(x) < y * fieldWidth + x;
+        }
+    }
+
+    // 场地上的格子集合，格子 (x, y) 对应第 y * fieldWidth + x 位，第 i 格在 word[i / 64]
+    // 字数按格子数在编译期选定：9x9 是两个字，不超过 64 格的场地只用一个字
+    template<int Words>
+    struct BasicBitboard {
+        unsigned long long word[Words] = {};
+
+        static int Index(int x, int y) {
+            return y * fieldWidth + x;
+        }
+
+        bool Test(int x, int y) const {
+            if (!CoordValid(x, y))return false;
+            int i = Index(x, y);
+            return word[i >> 6] >> (i & 63) & 1;
+        }
+
+        void Set(int x, int y) {
+            int i = Index(x, y);
+            word[i >> 6] |= 1ull << (i & 63);
+        }
+
+        bool Any() const {
+            for (int i = 0; i < Words; i++)
+                if (word[i])return true;
+            return false;
+        }
+
+        BasicBitboard operator&(const BasicBitboard &b) const {
+            BasicBitboard r;
+            for (int i = 0; i < Words; i++)
+                r.word[i] = word[i] & b.word[i];
+            return r;
+        }
+
+        BasicBitboard operator|(const BasicBitboard &b) const {
+            BasicBitboard r;
+            for (int i = 0; i < Words; i++)
+                r.word[i] = word[i] | b.word[i];
+            return r;
+        }
+
+        BasicBitboard &operator|=(const BasicBitboard &b) {
+            for (int i = 0; i < Words; i++)
+                word[i] |= b.word[i];
+            return *this;
+        }
+
+        // 去掉 b 中的格子
+        BasicBitboard Without(const BasicBitboard &b) const {
+            BasicBitboard r;
+            for (int i = 0; i < Words; i++)
+                r.word[i] = word[i] & ~b.word[i];
+            return r;
+        }
+    };
+
+    using Bitboard = BasicBitboard<(cellCount + 63) / 64>;
+
+    // full[dir][y][x]：从 (x, y) 沿 dir 直到场地边缘的所有格子（不含起点）
+    namespace Rays {
+        Bitboard full[4][fieldHeight][fieldWidth];
+
+        struct Initializer {
+            Initializer() {
+                for (int dir = 0; dir < 4; ++dir)
+                    for (int c = 0; c < cellCount; ++c)
+                        for (int k = 0; k < geometry.rayLength[c][dir]; ++k) {
+                            int n = geometry.ray[c][dir][k];
+                            full[dir][geometry.y[c]][geometry.x[c]].Set(geometry.x[n], geometry.y[n]);
+                        }
+            }
+        } initializer;
+    }
+
     namespace Utility {
 
-        pair<int, int> q[fieldHeight * fieldWidth];
-        int head, tail;
-
-        void BFSDistance(int x, int y, FieldItem (*gameField)[fieldWidth], int (*dis)[fieldWidth]) {
-            for (int i = 0; i < fieldHeight; ++i)for (int j = 0; j < fieldWidth; ++j)dis[i][j] = (int) 1e9;
-            dis[y][x] = 0;
-            head = 0;
-            tail = 0;
-            q[tail++] = make_pair(x, y);
-            while (head < tail) {
-                auto[tx, ty]=q[head];
-                int d = dis[ty][tx];
-                for (int i = head; i < tail; ++i) {
-                    auto p = q[i];
-                    if (dis[p.second][p.first] > d)break;
-                    for (int o = 0; o < 4; ++o) {
-                        int nx = p.first + dx[o];
-                        int ny = p.second + dy[o];
-                        if (CoordValid(nx, ny) && (gameField[ny][nx] & (Brick | Steel | Water)) == 0 &&
-                            dis[ny][nx] == (int) 1e9) {
-                            dis[ny][nx] = d + 1;
-                            if (gameField[ny][nx] != Base)q[tail++] = make_pair(nx, ny);
+        // BFS/DFS 的临时数组，每个搜索上下文各有一份，显式传给下面的函数
+        struct Scratch {
+            short q[cellCount];
+            int head, tail;
+            bool vis[cellCount];
+        };
+
+        // BFSDistance 的结果只与地形（砖、钢、水、基地）和起点有关，按 (地形哈希, 起点) 缓存
+        // 键取 Symmetry 的规范方向，旋转时起点和整张距离表一起旋转；跨回合时通过 data 保存（见 Persistence）
+        namespace DistanceCache {
+            const int size = 4096;
+            const unsigned char infinity = 255;
+
+            struct Entry {
+                unsigned long long terrain;
+                unsigned char x, y;
+                bool used;
+                unsigned char dis[fieldHeight][fieldWidth];
+            };
+
+            Entry entries[size];
+
+            inline int Index(unsigned long long terrain, int x, int y) {
+                return (terrain ^ Zobrist::cell[y][x]) & (size - 1);
+            }
+
+            inline Entry &Slot(unsigned long long terrain, int x, int y) {
+                return entries[Index(terrain, x, y)];
+            }
+
+            // 整张表由所有搜索共享；开启 ALPHATANK_THREADS 时按槽位分段加锁
+#ifdef ALPHATANK_THREADS
+            const int lockCount = 64;
+            std::mutex locks[lockCount];
+
+            struct Guard {
+                std::lock_guard<std::mutex> lock;
+
+                explicit Guard(int index) : lock(locks[index % lockCount]) {}
+            };
+#else
+            struct Guard {
+                explicit Guard(int) {}
+            };
+#endif
+
+            // 换到规范方向，返回是否旋转
+            inline bool Canonical(unsigned long long &terrain, unsigned long long mirror, int &x, int &y) {
+                if (!Symmetry::Rotated(terrain, mirror, Symmetry::CellTie(x, y)))return false;
+                terrain = mirror;
+                x = Symmetry::RotateX(x);
+                y = Symmetry::RotateY(y);
+                return true;
+            }
+
+            bool Lookup(unsigned long long terrain, unsigned long long mirror, int x, int y, int (*dis)[fieldWidth]) {
+                bool rotated = Canonical(terrain, mirror, x, y);
+                int index = Index(terrain, x, y);
+                Guard guard(index);
+                Entry &e = entries[index];
+                if (!e.used || e.terrain != terrain || e.x != x || e.y != y)return false;
+                for (int i = 0; i < fieldHeight; ++i)
+                    for (int j = 0; j < fieldWidth; ++j) {
+                        unsigned char d = rotated ? e.dis[Symmetry::RotateY(i)][Symmetry::RotateX(j)] : e.dis[i][j];
+                        dis[i][j] = d == infinity ? (int) 1e9 : d;
+                    }
+                return true;
+            }
+
+            void Store(unsigned long long terrain, unsigned long long mirror, int x, int y, int (*dis)[fieldWidth]) {
+                bool rotated = Canonical(terrain, mirror, x, y);
+                int index = Index(terrain, x, y);
+                Guard guard(index);
+                Entry &e = entries[index];
+                e.terrain = terrain;
+                e.x = x;
+                e.y = y;
+                e.used = true;
+                for (int i = 0; i < fieldHeight; ++i)
+                    for (int j = 0; j < fieldWidth; ++j) {
+                        int d = rotated ? dis[Symmetry::RotateY(i)][Symmetry::RotateX(j)] : dis[i][j];
+                        e.dis[i][j] = d >= infinity ? infinity : d;
+                    }
+            }
+        }
+
+        void BFSDistance(Scratch &scratch, int x, int y, FieldItem (*gameField)[fieldWidth], int (*dis)[fieldWidth]) {
+            const FieldItem *cells = gameField[0];
+            int *d = dis[0];
+            std::fill(d, d + cellCount, (int) 1e9);
+            d[geometry.Cell(x, y)] = 0;
+            scratch.head = 0;
+            scratch.tail = 0;
+            scratch.q[scratch.tail++] = geometry.Cell(x, y);
+            while (scratch.head < scratch.tail) {
+                int level = d[scratch.q[scratch.head]];
+                for (int i = scratch.head; i < scratch.tail; ++i) {
+                    int c = scratch.q[i];
+                    if (d[c] > level)break;
+                    for (int k = 0; k < geometry.degree[c]; ++k) {
+                        int n = geometry.neighbours[c][k];
+                        if ((cells[n] & (Brick | Steel | Water)) == 0 && d[n] == (int) 1e9) {
+                            d[n] = level + 1;
+                            if (cells[n] != Base)scratch.q[scratch.tail++] = n;
                         }
                     }
                 }
-                while (head < tail) {
-                    auto[ttx, tty]=q[head];
-                    if (dis[tty][ttx] > d)break;
-                    ++head;
-                    for (int o = 0; o < 4; ++o) {
-                        int nx = ttx + dx[o];
-                        int ny = tty + dy[o];
-                        if (CoordValid(nx, ny) && (gameField[ny][nx] & (Steel | Base | Water)) == 0 &&
-                            (gameField[ny][nx] & Brick) != 0 &&
-                            dis[ny][nx] == (int) 1e9) {
-                            dis[ny][nx] = d + 2;
-                            q[tail++] = make_pair(nx, ny);
+                while (scratch.head < scratch.tail) {
+                    int c = scratch.q[scratch.head];
+                    if (d[c] > level)break;
+                    ++scratch.head;
+                    for (int k = 0; k < geometry.degree[c]; ++k) {
+                        int n = geometry.neighbours[c][k];
+                        if ((cells[n] & (Steel | Base | Water)) == 0 && (cells[n] & Brick) != 0 && d[n] == (int) 1e9) {
+                            d[n] = level + 2;
+                            scratch.q[scratch.tail++] = n;
                         }
                     }
                 }
@@ -234,54 +649,350 @@ namespace TankGame {
         }
 
 
-        void BFSBestPath(int baseY, FieldItem (*gameField)[fieldWidth], int (*dis)[fieldWidth],
-                         bool (*goodPath)[fieldWidth], bool (*goodDir)[fieldHeight][4]) {
-            memset(goodDir, 0, sizeof(&goodDir));
-            head = 0;
-            tail = 0;
+        void BFSBestPath(Scratch &scratch, int baseY, FieldItem (*gameField)[fieldWidth], int (*dis)[fieldWidth],
+                         bool (*goodPath)[fieldWidth], bool (*goodDir)[fieldWidth][4]) {
+            const FieldItem *cells = gameField[0];
+            const int *d = dis[0];
+            bool *good = goodPath[0];
+            memset(goodDir, 0, sizeof(bool) * fieldHeight * fieldWidth * 4);
+            scratch.head = 0;
+            scratch.tail = 0;
             for (int tx = 0; tx < fieldWidth; ++tx)
                 for (int ty = 0; ty < fieldHeight; ++ty)
-                    if (goodPath[ty][tx])q[tail++] = make_pair(tx, ty);
-            while (head < tail) {
-                auto[x, y]=q[head++];
+                    if (goodPath[ty][tx])scratch.q[scratch.tail++] = geometry.Cell(tx, ty);
+            while (scratch.head < scratch.tail) {
+                int c = scratch.q[scratch.head++];
                 for (int o = 0; o < 4; ++o) {
-                    int nx = x - dx[o];
-                    int ny = y - dy[o];
-                    if (CoordValid(nx, ny) && !goodPath[ny][nx] &&
-                        dis[y][x] - dis[ny][nx] == ((gameField[y][x] & Brick) ? 2 : 1)) {
-                        goodPath[ny][nx] = true;
-                        goodDir[ny][nx][o] = true;
-                        q[tail++] = make_pair(nx, ny);
+                    int n = geometry.step[c][(o + 2) % 4];
+                    if (n >= 0 && !good[n] && d[c] - d[n] == ((cells[c] & Brick) ? 2 : 1)) {
+                        good[n] = true;
+                        goodDir[geometry.y[n]][geometry.x[n]][o] = true;
+                        scratch.q[scratch.tail++] = n;
                     }
                 }
             }
         }
 
-        bool vis[fieldHeight][fieldWidth];
-
         // water don't block the way
-        void dfs(int x1, int y1, FieldItem (*gameField)[fieldWidth]) {
-            vis[y1][x1] = true;
-            for (int i = 0; i < 4; ++i) {
-                int x = x1 + dx[i], y = y1 + dy[i];
-                if (CoordValid(x, y) && !vis[y][x] && (gameField[y][x] & (Brick | Steel | Base | Water)) == 0) {
-                    dfs(x, y, gameField);
-                }
+        void dfs(Scratch &scratch, int c, const FieldItem *cells) {
+            scratch.vis[c] = true;
+            for (int k = 0; k < geometry.degree[c]; ++k) {
+                int n = geometry.neighbours[c][k];
+                if (!scratch.vis[n] && (cells[n] & (Brick | Steel | Base | Water)) == 0)
+                    dfs(scratch, n, cells);
             }
         }
 
-        bool IsLink(int x1, int y1, int x2, int y2, FieldItem (*gameField)[fieldWidth]) {
+        bool IsLink(Scratch &scratch, int x1, int y1, int x2, int y2, FieldItem (*gameField)[fieldWidth]) {
             if (x1 == -1 || x2 == -1)return false;
-            memset(vis, 0, sizeof(vis));
+            memset(scratch.vis, 0, sizeof(scratch.vis));
             if (gameField[y1][x1] & (Brick | Steel | Base | Water))return 0;
-            dfs(x1, y1, gameField);
-            return vis[y2][x2];
+            dfs(scratch, geometry.Cell(x1, y1), gameField[0]);
+            return scratch.vis[geometry.Cell(x2, y2)];
         }
     }
 
-    class TankField {
-    public:
-        //!//!//!// 以下变量设计为只读，不推荐进行修改 //!//!//!//
+    // 抢攻基地回合数的估计：不考虑其他坦克时，一个坦克从某个格子出发（区分上回合是否射击）打掉基地要几回合
+    // 开火位置是基地所在行（左侧、右侧）或所在列上、与基地之间没有钢墙的格子，中间每块砖要多打一枪
+    // 移动进砖块格子先打掉再进去，算两回合；不能连续两回合射击
+    // 这是一个启发式的上界，不是精确的最短回合数：每条计入的路线都走得通，但
+    //   砖块按初始地形静态计价，路上打掉的砖不会让开火线上少打一枪，开火线上打掉的砖也不会让路变短；
+    //   只考虑打相邻的砖开路，不考虑隔几格先把砖打掉；开火位置限定在 flanks 允许的方位上
+    // 精确值要在（格子, 冷却, 已打掉的砖）状态上搜索，估值里只用来比较双方快慢，这个粗略的上界就够了
+    namespace Race {
+        // 允许的开火位置，可以组合：基地所在行的左侧、右侧，基地所在列，或只是基地正前方的一格
+        enum Flank {
+            LeftFlank = 1,
+            RightFlank = 2,
+            Column = 4,
+            Front = 8
+        };
+
+        const unsigned char unreachable = 255;
+
+        // 坦克能站的格子，砖块打掉以后也能站
+        inline bool Passable(FieldItem item) {
+            return canStand(item) || item == Brick;
+        }
+
+        struct Table {
+            unsigned long long terrain = 0;
+            int target = -1, flanks = 0;
+            // turns[y][x][justShot]
+            unsigned char turns[fieldHeight][fieldWidth][2];
+        };
+
+        // 从 (x, y) 射向 target 方的基地要先打掉几块砖；不在允许的开火位置或被钢墙挡住返回 -1
+        int BricksToBase(FieldItem (*gameField)[fieldWidth], int x, int y, int target, int flanks) {
+            int bx = baseX[target], by = baseY[target];
+            if (x == bx && y == by)return -1;
+            if (y == by) {
+                if (!(flanks & (x < bx ? LeftFlank : RightFlank)))return -1;
+            } else if (x != bx || !(flanks & (std::abs(y - by) == 1 ? Column | Front : Column)))
+                return -1;
+            int sx = x < bx ? 1 : x > bx ? -1 : 0, sy = y < by ? 1 : y > by ? -1 : 0, bricks = 0;
+            for (x += sx, y += sy; x != bx || y != by; x += sx, y += sy) {
+                if (gameField[y][x] & Steel)return -1;
+                if (gameField[y][x] & Brick)++bricks;
+            }
+            return bricks;
+        }
+
+        void Build(FieldItem (*gameField)[fieldWidth], int target, int flanks, Table &table) {
+            const int inf = unreachable;
+            const FieldItem *cells = gameField[0];
+            int cost[cellCount][2];
+            for (int c = 0; c < cellCount; ++c) {
+                int bricks = Passable(cells[c]) ? BricksToBase(gameField, geometry.x[c], geometry.y[c], target, flanks) : -1;
+                // 共 bricks + 1 枪，每两枪之间隔一回合；上回合射击过要先等一回合
+                cost[c][0] = bricks < 0 ? inf : 2 * bricks + 1;
+                cost[c][1] = bricks < 0 ? inf : 2 * bricks + 2;
+            }
+            // 图只有 162 个点，反复松弛到不再变化
+            for (bool changed = true; changed;) {
+                changed = false;
+                for (int c = 0; c < cellCount; ++c) {
+                    if (!Passable(cells[c]))continue;
+                    for (int shot = 0; shot < 2; ++shot) {
+                        int best = min(cost[c][shot], cost[c][0] + 1);
+                        for (int k = 0; k < geometry.degree[c]; ++k) {
+                            int n = geometry.neighbours[c][k];
+                            if (canStand(cells[n]))
+                                best = min(best, cost[n][0] + 1);
+                            else if (cells[n] == Brick && !shot)
+                                best = min(best, cost[n][0] + 2);
+                        }
+                        if (best < cost[c][shot]) {
+                            cost[c][shot] = best;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            for (int c = 0; c < cellCount; ++c)
+                for (int shot = 0; shot < 2; ++shot)
+                    table.turns[geometry.y[c]][geometry.x[c]][shot] = (unsigned char) min(cost[c][shot], inf);
+            table.target = target;
+            table.flanks = flanks;
+        }
+
+        // 旋转 180° 以后基地换成对方的，行上的左右两侧互换
+        inline int RotateFlanks(int flanks) {
+            return (flanks & ~(LeftFlank | RightFlank)) | (flanks & LeftFlank ? RightFlank : 0) |
+                   (flanks & RightFlank ? LeftFlank : 0);
+        }
+
+        // 按地形哈希缓存的抢攻表，每个搜索上下文一份
+        // 表存在 Symmetry 的规范方向上，蓝方左路和红方右路这样互为旋转的两张表只建一次
+        struct Cache {
+            static const int size = 64;
+            Table entries[size];
+
+            // 坦克在 (x, y)、上回合是否射击时抢攻回合数的上界；mirror 是旋转后地形的哈希
+            int Bound(unsigned long long terrain, unsigned long long mirror, FieldItem (*gameField)[fieldWidth],
+                      int target, int flanks, int x, int y, bool justShot) {
+                bool rotated = Symmetry::Rotated(terrain, mirror, target == Blue);
+                unsigned long long key = rotated ? mirror : terrain;
+                int keyTarget = rotated ? !target : target, keyFlanks = rotated ? RotateFlanks(flanks) : flanks;
+                Table &table = entries[(key ^ (key >> 29) ^ (unsigned) (keyTarget * 16 + keyFlanks) * 0x9E3779B9u) & (size - 1)];
+                if (table.terrain != key || table.target != keyTarget || table.flanks != keyFlanks) {
+                    Build(gameField, target, flanks, table);
+                    if (rotated)
+                        for (int c = 0; c < fieldHeight * fieldWidth / 2; ++c)
+                            for (int shot = 0; shot < 2; ++shot)
+                                std::swap(table.turns[c / fieldWidth][c % fieldWidth][shot],
+                                          table.turns[Symmetry::RotateY(c / fieldWidth)][Symmetry::RotateX(c % fieldWidth)][shot]);
+                    table.terrain = key;
+                    table.target = keyTarget;
+                    table.flanks = keyFlanks;
+                }
+                if (rotated)
+                    x = Symmetry::RotateX(x), y = Symmetry::RotateY(y);
+                return table.turns[y][x][justShot];
+            }
+        };
+    }
+
+#ifdef ALPHATANK_NETWORK
+    // 可选的量化神经网络估值（编译时定义 ALPHATANK_NETWORK 开启，没有加载到权重时仍用 EstimateAttack）
+    // 输入是特征平面：从某一方的视角看（红方视角把场地旋转 180° 并交换双方，见 Symmetry），每个格子 9 个平面
+    //   砖、钢、水、我方基地、对方基地、我方 0/1 号坦克、对方 0/1 号坦克，再加 4 个坦克上回合射击过的特征
+    // 第一层对双方视角各算一个 int16 累加器（偏置加上所有激活特征的权重行），截断到 [0, 127]
+    // 累加器存在 TankField::accumulator 里，随 DoAction 按变化的特征增量更新，叶子上只剩输出层要算
+    // 输出层按配对的坦克号各有一组 int8 权重，作用在 [我方视角, 对方视角] 两段上，结果除以 divisor
+    // 权重是小端二进制：
+    //   "ATNN" int32 版本(1) int32 特征数 int32 隐层宽度 int32 divisor
+    //   int16 bias[hidden]  int16 weight[features][hidden]  int8 output[tankPerSide][2][hidden]  int32 outputBias[tankPerSide]
+    // 定义 ALPHATANK_NETWORK_WEIGHTS 为一个头文件时，从其中的 networkWeights[] 数组读取（编译期嵌入）；
+    // 否则运行时读环境变量 ALPHATANK_NETWORK_FILE 指定的文件，默认 alphatank.nn
+    namespace Network {
+        const int planes = 9, features = planes * cellCount + sideCount * tankPerSide, hidden = 32;
+
+        enum Plane {
+            BrickPlane, SteelPlane, WaterPlane, OwnBasePlane, EnemyBasePlane, OwnTankPlane, EnemyTankPlane = OwnTankPlane + 2
+        };
+
+        alignas(32) short bias[hidden], weight[features][hidden];
+        // 输出层权重扩展成 int16，方便和截断后的隐层做 16 位乘加
+        alignas(32) short output[tankPerSide][2][hidden];
+        int outputBias[tankPerSide], divisor = 1;
+        bool ready = false;
+
+        // perspective 视角下 (x, y) 格子第 plane 个平面的特征编号
+        inline int CellFeature(int perspective, int plane, int x, int y) {
+            int cell = geometry.Cell(x, y);
+            return plane * cellCount + (perspective == Blue ? cell : cellCount - 1 - cell);
+        }
+
+        inline int ShotFeature(int perspective, int side, int tank) {
+            return planes * cellCount + (side == perspective ? 0 : tankPerSide) + tank;
+        }
+
+        inline int TankFeature(int perspective, int side, int tank, int x, int y) {
+            return CellFeature(perspective, (side == perspective ? OwnTankPlane : EnemyTankPlane) + tank, x, y);
+        }
+
+        inline int BaseFeature(int perspective, int side) {
+            return CellFeature(perspective, side == perspective ? OwnBasePlane : EnemyBasePlane, baseX[side], baseY[side]);
+        }
+
+        // 增量更新：累加器加上（sign = 1）或减去（sign = -1）一个特征的权重行
+        inline void AddFeature(short acc[hidden], int feature, int sign) {
+            const short *row = weight[feature];
+            if (sign > 0)
+                for (int i = 0; i < hidden; i++)acc[i] += row[i];
+            else
+                for (int i = 0; i < hidden; i++)acc[i] -= row[i];
+        }
+
+        // 从前往后读小端整数
+        struct Reader {
+            const unsigned char *p, *end;
+
+            bool Get(void *out, size_t n) {
+                if ((size_t) (end - p) < n)return false;
+                memcpy(out, p, n);
+                p += n;
+                return true;
+            }
+
+            int Int() {
+                int v = 0;
+                return Get(&v, 4) ? v : -1;
+            }
+        };
+
+        bool Load(const unsigned char *data, size_t size) {
+            Reader in{data, data + size};
+            char magic[4];
+            signed char out8[tankPerSide][2][hidden];
+            ready = in.Get(magic, 4) && !memcmp(magic, "ATNN", 4) && in.Int() == 1 && in.Int() == features &&
+                    in.Int() == hidden && (divisor = in.Int()) > 0 && in.Get(bias, sizeof(bias)) &&
+                    in.Get(weight, sizeof(weight)) && in.Get(out8, sizeof(out8)) &&
+                    in.Get(outputBias, sizeof(outputBias));
+            for (int tank = 0; tank < tankPerSide; tank++)
+                for (int half = 0; half < 2; half++)
+                    for (int i = 0; i < hidden; i++)
+                        output[tank][half][i] = out8[tank][half][i];
+            return ready;
+        }
+
+#ifdef ALPHATANK_NETWORK_WEIGHTS
+#include ALPHATANK_NETWORK_WEIGHTS
+
+        void Init() {
+            Load(networkWeights, sizeof(networkWeights));
+        }
+#else
+
+        void Init() {
+            const char *path = getenv("ALPHATANK_NETWORK_FILE");
+            FILE *file = fopen(path ? path : "alphatank.nn", "rb");
+            if (!file)return;
+            vector<unsigned char> data;
+            unsigned char buf[4096];
+            for (size_t n; (n = fread(buf, 1, sizeof(buf), file)) > 0;)
+                data.insert(data.end(), buf, buf + n);
+            fclose(file);
+            Load(data.data(), data.size());
+        }
+#endif
+
+        void AccumulateScalar(const int active[], int n, short acc[hidden]) {
+            memcpy(acc, bias, sizeof(bias));
+            for (int k = 0; k < n; k++)
+                for (int i = 0; i < hidden; i++)
+                    acc[i] += weight[active[k]][i];
+        }
+
+        // us 是配对坦克一方视角的累加器，them 是另一方的
+        int OutputScalar(const short us[hidden], const short them[hidden], int tank) {
+            int sum = outputBias[tank];
+            for (int i = 0; i < hidden; i++)
+                sum += output[tank][0][i] * min(max((int) us[i], 0), 127) +
+                       output[tank][1][i] * min(max((int) them[i], 0), 127);
+            return sum;
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        // AVX2 版本：hidden = 32 正好是两个 256 位寄存器；运行时 CPU 不支持时走上面的标量版本
+        static_assert(hidden == 32, "AVX2 版本按 32 个隐层单元展开");
+
+        __attribute__((target("avx2")))
+        void AccumulateAvx2(const int active[], int n, short acc[hidden]) {
+            __m256i a0 = _mm256_load_si256((const __m256i *) bias);
+            __m256i a1 = _mm256_load_si256((const __m256i *) (bias + 16));
+            for (int k = 0; k < n; k++) {
+                a0 = _mm256_add_epi16(a0, _mm256_load_si256((const __m256i *) weight[active[k]]));
+                a1 = _mm256_add_epi16(a1, _mm256_load_si256((const __m256i *) (weight[active[k]] + 16)));
+            }
+            _mm256_storeu_si256((__m256i *) acc, a0);
+            _mm256_storeu_si256((__m256i *) (acc + 16), a1);
+        }
+
+        __attribute__((target("avx2")))
+        int OutputAvx2(const short us[hidden], const short them[hidden], int tank) {
+            const __m256i zero = _mm256_setzero_si256(), top = _mm256_set1_epi16(127);
+            __m256i sum = _mm256_setzero_si256();
+            for (int half = 0; half < 2; half++)
+                for (int i = 0; i < hidden; i += 16) {
+                    __m256i h = _mm256_loadu_si256((const __m256i *) ((half ? them : us) + i));
+                    h = _mm256_min_epi16(_mm256_max_epi16(h, zero), top);
+                    __m256i w = _mm256_load_si256((const __m256i *) (output[tank][half] + i));
+                    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(h, w));
+                }
+            __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+            return outputBias[tank] + _mm_cvtsi128_si32(s);
+        }
+
+        const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+        const bool avx2 = false;
+#endif
+
+        void Accumulate(const int active[], int n, short acc[hidden]) {
+#if defined(__x86_64__) || defined(__i386__)
+            if (avx2)return AccumulateAvx2(active, n, acc);
+#endif
+            AccumulateScalar(active, n, acc);
+        }
+
+        int Output(const short us[hidden], const short them[hidden], int tank) {
+#if defined(__x86_64__) || defined(__i386__)
+            if (avx2)return OutputAvx2(us, them, tank);
+#endif
+            return OutputScalar(us, them, tank);
+        }
+    }
+#endif
+
+    // 局面的核心状态：只包含规则需要的信息，按值复制就是一个完整的快照
+    // 过往动作和回退日志放在 TankField 里，搜索用的缓存放在 Workspace 里
+    struct TankState {
+        // 场上砖块和基地的 Zobrist 哈希，随 DoAction/Revert 增量维护
+        unsigned long long terrainHash = 0;
 
         // 游戏场地上的物件（一个格子上可能有多个坦克）
         FieldItem gameField[fieldHeight][fieldWidth] = {};
@@ -294,17 +1005,41 @@ namespace TankGame {
         bool baseAlive[sideCount] = {true, true};
 
         // 坦克横坐标，-1表示坦克已炸
-        int tankX[sideCount][tankPerSide] = {
+        signed char tankX[sideCount][tankPerSide] = {
                 {fieldWidth / 2 - 2, fieldWidth / 2 + 2},
                 {fieldWidth / 2 + 2, fieldWidth / 2 - 2}
         };
 
         // 坦克纵坐标，-1表示坦克已炸
-        int tankY[sideCount][tankPerSide] = {{0,               0},
-                                             {fieldHeight - 1, fieldHeight - 1}};
+        signed char tankY[sideCount][tankPerSide] = {{0,               0},
+                                                     {fieldHeight - 1, fieldHeight - 1}};
+
+        // 当前回合编号（不超过 drawTurn + 1）
+        unsigned char currentTurn = 1;
+    };
+
+    static_assert(sizeof(FieldItem) == 1 && sizeof(Action) == 1, "格子和动作各占一个字节");
+    static_assert(sizeof(TankState) <= (cellCount + 23 + alignof(TankState) - 1) / alignof(TankState) * alignof(TankState),
+                  "TankState 除格子外只占 23 字节（再加对齐填充），9x9 时是 104 字节");
+
+    // 搜索时按坦克计算的距离表，只依赖局面；stamp 与 TankField::version 不同即视为过期
+    struct SearchCache {
+        int dis[sideCount][tankPerSide][fieldHeight][fieldWidth]{0};
+        bool goodPath[sideCount][tankPerSide][fieldHeight][fieldWidth]{false};
+        bool goodDir[sideCount][tankPerSide][fieldHeight][fieldWidth][4]{false};
+        unsigned stamp[sideCount][tankPerSide]{0};
+    };
+
+    // 搜索的工作区：BFS 临时数组和距离缓存，需要它们的 TankField 函数显式接收
+    struct Workspace {
+        Utility::Scratch scratch;
+        SearchCache cache;
+        Race::Cache races;
+    };
 
-        // 当前回合编号
-        int currentTurn = 1;
+    class TankField : public TankState {
+    public:
+        //!//!//!// 以下变量设计为只读，不推荐进行修改 //!//!//!//
 
         // 我是哪一方
         int mySide;
@@ -312,11 +1047,34 @@ namespace TankGame {
         // 用于回退的log
         stack<DisappearLog> logs;
 
+        // 局面版本，每次 DoAction/Revert 都会变化，用来判断 cache 是否过期
+        unsigned version = 1;
+
+        // 把地形旋转 180° 以后的 terrainHash（见 Symmetry），和 terrainHash 一起维护
+        unsigned long long mirrorHash = 0;
+
+#ifdef ALPHATANK_NETWORK
+        // accumulator[t][perspective]：第 t 回合的局面在两个视角下的网络第一层累加器（见 Network）
+        // 加载了权重时 DoAction 由第 t 回合的累加器加减变化的特征得到第 t + 1 回合的，Revert 不需要做什么
+        alignas(32) short accumulator[drawTurn + 2][sideCount][Network::hidden];
+#endif
+
+        // firstBlock[dir][y][x]：从 (x, y) 沿 dir 走到第一个挡子弹的地形要几步，没有则为走出场地的步数
+        // 只随砖块和基地的消失/恢复变化，由 _updateRays 按行列重算
+        unsigned char firstBlock[4][fieldHeight][fieldWidth];
+
         // 过往动作（previousActions[x] 表示所有人在第 x 回合的动作，第 0 回合的动作没有意义）
-        Action previousActions[106][sideCount][tankPerSide] = {{{Stay, Stay}, {Stay, Stay}}};
+        Action previousActions[drawTurn + 1][sideCount][tankPerSide] = {{{Stay, Stay}, {Stay, Stay}}};
 
         //!//!//!// 以上变量设计为只读，不推荐进行修改 //!//!//!//
 
+        // 威胁图，按回合存：DoAction 把没受影响的坦克沿用到下一回合，受影响的标记为过期，查询时再重算；Revert 不需要回退
+        // fireLines[t][side][tank]：第 t 回合坦克所在格向四个方向射击能打到的格子，不管上回合是否射击过，已死为空
+        // threatNext[t][side][tank]：第 t 回合坦克不射击（原地或移动一步）时，下回合能打到的格子
+        // threatStale[t][side][tank]：第 1 位表示 fireLines 过期，第 2 位表示 threatNext 过期
+        Bitboard fireLines[drawTurn + 2][sideCount][tankPerSide], threatNext[drawTurn + 2][sideCount][tankPerSide];
+        unsigned char threatStale[drawTurn + 2][sideCount][tankPerSide];
+
         // 本回合双方即将执行的动作，需要手动填入
         Action nextAction[sideCount][tankPerSide] = {{Invalid, Invalid},
                                                      {Invalid, Invalid}};
@@ -336,6 +1094,26 @@ namespace TankGame {
             return CoordValid(x, y) && gameField[y][x] == None;
         }
 
+        // 一次算出坦克的全部合法动作，按 ActionBit 组成掩码，与逐个调用 ActionIsValid 的结果相同
+        unsigned LegalActions(int side, int tank) {
+            unsigned legal = ActionBit(Stay);
+            if (!tankAlive[side][tank])
+                return legal;
+            if (!JustShoot(side, tank))
+                legal |= ActionBit(UpShoot) | ActionBit(RightShoot) | ActionBit(DownShoot) | ActionBit(LeftShoot);
+            for (int dir = Up; dir <= Left; dir++)
+                if (CanMove(tankX[side][tank], tankY[side][tank], (Action) dir))
+                    legal |= ActionBit((Action) dir);
+            return legal;
+        }
+
+        // 所有坦克的合法动作掩码
+        void LegalActions(unsigned legal[sideCount][tankPerSide]) {
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    legal[side][tank] = LegalActions(side, tank);
+        }
+
         bool CanMove(int x, int y, Action act) {
             x += dx[act];
             y += dy[act];
@@ -359,7 +1137,7 @@ namespace TankGame {
         }
 
         void _revertTank(int side, int tank, DisappearLog &log) {
-            int &currX = tankX[side][tank], &currY = tankY[side][tank];
+            signed char &currX = tankX[side][tank], &currY = tankY[side][tank];
             if (tankAlive[side][tank])
                 gameField[currY][currX] &= ~tankItemTypes[side][tank];
             else
@@ -369,19 +1147,169 @@ namespace TankGame {
             gameField[currY][currX] |= tankItemTypes[side][tank];
         }
 
-    public:
-
-        bool hasDestroyBlock[sideCount][tankPerSide][106];
-
-        // 执行 nextAction 中指定的行为并进入下一回合，返回行为是否合法
-        bool DoAction() {
-            if (!ActionIsValid())
-                return false;
+        // lines 是坦克所在格的 FireLines
+        Bitboard _nextThreat(int side, int tank, const Bitboard &lines) {
+            int x = tankX[side][tank], y = tankY[side][tank];
+            Bitboard threat = lines;
+            for (int dir = 0; dir < 4; ++dir)
+                if (CanMove(x, y, (Action) dir))
+                    threat |= FireLines(x + dx[dir], y + dy[dir]);
+            return threat;
+        }
 
-            for (int side = 0; side < sideCount; side++)
-                for (int tank = 0; tank < tankPerSide; tank++)
-                    hasDestroyBlock[side][tank][currentTurn] = false;
-            // 1 移动
+        // 由第 currentTurn 回合的威胁图和这回合的变化推出第 currentTurn + 1 回合的
+        // moved：移动过或被打掉的坦克；occupied：有坦克离开、进入或被打掉的格子；terrain：消失的砖块和基地
+        // 射线只在坦克动过或同一行列的地形变了时过期；下回合的威胁还要看四邻能不能走进去
+        void _updateThreats(const bool moved[sideCount][tankPerSide], const Bitboard &occupied, const Bitboard &terrain) {
+            int t = currentTurn;
+            bool terrainChanged = terrain.Any();
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    unsigned char &stale = threatStale[t + 1][side][tank];
+                    if (!tankAlive[side][tank]) {
+                        fireLines[t + 1][side][tank] = threatNext[t + 1][side][tank] = Bitboard();
+                        stale = 0;
+                        continue;
+                    }
+                    int x = tankX[side][tank], y = tankY[side][tank];
+                    stale = moved[side][tank] ? 3 : threatStale[t][side][tank];
+                    if (terrainChanged)
+                        stale |= 2;
+                    for (int dir = 0; dir < 4 && !(stale & 1) && terrainChanged; ++dir)
+                        if ((Rays::full[dir][y][x] & terrain).Any())
+                            stale |= 1;
+                    for (int dir = 0; dir < 4 && !(stale & 2); ++dir)
+                        if (occupied.Test(x + dx[dir], y + dy[dir]))
+                            stale |= 2;
+                    if (!(stale & 1))
+                        fireLines[t + 1][side][tank] = fireLines[t][side][tank];
+                    if (!(stale & 2))
+                        threatNext[t + 1][side][tank] = threatNext[t][side][tank];
+                }
+        }
+
+#ifdef ALPHATANK_NETWORK
+        // 由本回合开始时的状态 before 和执行完动作的当前状态，算出第 currentTurn + 1 回合的累加器
+        void _updateAccumulator(const TankState &before) {
+            short (*next)[Network::hidden] = accumulator[currentTurn + 1];
+            memcpy(next, accumulator[currentTurn], sizeof(accumulator[0]));
+            auto toggle = [&](int sign, auto feature) {
+                for (int p = 0; p < sideCount; p++)
+                    Network::AddFeature(next[p], feature(p), sign);
+            };
+            if (before.terrainHash != terrainHash)
+                for (int y = 0; y < fieldHeight; y++)
+                    for (int x = 0; x < fieldWidth; x++)
+                        if ((before.gameField[y][x] & Brick) && !(gameField[y][x] & Brick))
+                            toggle(-1, [&](int p) { return Network::CellFeature(p, Network::BrickPlane, x, y); });
+            for (int side = 0; side < sideCount; side++) {
+                if (before.baseAlive[side] && !baseAlive[side])
+                    toggle(-1, [&](int p) { return Network::BaseFeature(p, side); });
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    int x = tankX[side][tank], y = tankY[side][tank], bx = before.tankX[side][tank], by = before.tankY[side][tank];
+                    bool moved = x != bx || y != by;
+                    if (before.tankAlive[side][tank] && (moved || !tankAlive[side][tank]))
+                        toggle(-1, [&](int p) { return Network::TankFeature(p, side, tank, bx, by); });
+                    if (tankAlive[side][tank] && moved)
+                        toggle(1, [&](int p) { return Network::TankFeature(p, side, tank, x, y); });
+                    bool shotBefore = before.tankAlive[side][tank] && previousActions[currentTurn - 1][side][tank] > Left;
+                    bool shotNow = tankAlive[side][tank] && previousActions[currentTurn][side][tank] > Left;
+                    if (shotBefore != shotNow)
+                        toggle(shotNow ? 1 : -1, [&](int p) { return Network::ShotFeature(p, side, tank); });
+                }
+            }
+        }
+#endif
+
+        // (x, y) 上的砖块或基地出现或消失，更新两个方向的地形哈希
+        void _toggleTerrain(int x, int y) {
+            terrainHash ^= Zobrist::terrain[y][x];
+            mirrorHash ^= Zobrist::terrain[Symmetry::RotateY(y)][Symmetry::RotateX(x)];
+        }
+
+        // (x, y) 的地形变化后，重算所在行的左右射线和所在列的上下射线
+        void _updateRays(int x, int y) {
+            for (int i = 0; i < fieldWidth; i++)
+                firstBlock[Left][y][i] = i == 0 || BlocksShot(gameField[y][i - 1]) ? 1 : firstBlock[Left][y][i - 1] + 1;
+            for (int i = fieldWidth - 1; i >= 0; i--)
+                firstBlock[Right][y][i] = i == fieldWidth - 1 || BlocksShot(gameField[y][i + 1]) ? 1 :
+                                          firstBlock[Right][y][i + 1] + 1;
+            for (int j = 0; j < fieldHeight; j++)
+                firstBlock[Up][j][x] = j == 0 || BlocksShot(gameField[j - 1][x]) ? 1 : firstBlock[Up][j - 1][x] + 1;
+            for (int j = fieldHeight - 1; j >= 0; j--)
+                firstBlock[Down][j][x] = j == fieldHeight - 1 || BlocksShot(gameField[j + 1][x]) ? 1 :
+                                         firstBlock[Down][j + 1][x] + 1;
+        }
+
+        // 从 (x, y) 沿 dir 射击打到的第一个物件的距离（坦克也会挡住子弹），打出场地时该格坐标无效
+        int _shotRange(int x, int y, int dir) {
+            int range = firstBlock[dir][y][x];
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    if (!tankAlive[side][tank])continue;
+                    int ox = tankX[side][tank] - x, oy = tankY[side][tank] - y;
+                    int k = ox * dx[dir] + oy * dy[dir];
+                    if (k > 0 && k < range && ox == k * dx[dir] && oy == k * dy[dir])
+                        range = k;
+                }
+            return range;
+        }
+
+        // 第 currentTurn 回合的动作执行完后，更新 GetPattern 用的前缀信息
+        // 只依赖第 currentTurn 回合及以前，Revert 之后重新 DoAction 会覆盖，不需要回退
+        void _recordPattern() {
+            int t = currentTurn;
+            bool destroyed = false;
+            for (int side = 0; side < sideCount; side++) {
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    Action act = previousActions[t][side][tank];
+                    destroyed |= hasDestroyBlock[side][tank][t];
+                    moveX[side][tank][t] = moveX[side][tank][t - 1] + (ActionIsMove(act) ? dx[act] : 0);
+                    moveY[side][tank][t] = moveY[side][tank][t - 1] + (ActionIsMove(act) ? dy[act] : 0);
+                }
+                for (int cycle = 1; cycle <= maxCycle; cycle++) {
+                    bool same = t > cycle && previousActions[t][side][0] == previousActions[t - cycle][side][0] &&
+                                previousActions[t][side][1] == previousActions[t - cycle][side][1];
+                    repeatRun[cycle - 1][side][t] = same ? repeatRun[cycle - 1][side][t - 1] + 1 : 0;
+                }
+            }
+            lastDestroyTurn[t] = destroyed ? t : lastDestroyTurn[t - 1];
+        }
+
+    public:
+
+        bool hasDestroyBlock[sideCount][tankPerSide][drawTurn + 1];
+
+        // GetPattern 检测的最长周期
+        static const int maxCycle = 8;
+
+        // repeatRun[cycle - 1][side][t]：到第 t 回合为止，该方两个坦克的动作与 cycle 回合前相同的连续回合数
+        unsigned char repeatRun[maxCycle][sideCount][drawTurn + 1]{};
+
+        // moveX/moveY[side][tank][t]：前 t 回合移动的累计位移
+        signed char moveX[sideCount][tankPerSide][drawTurn + 1]{}, moveY[sideCount][tankPerSide][drawTurn + 1]{};
+
+        // 第 t 回合及以前最后一次有坦克打到东西的回合，没有为 0
+        unsigned char lastDestroyTurn[drawTurn + 1]{};
+
+        // 执行 nextAction 中指定的行为并进入下一回合，返回行为是否合法
+        bool DoAction() {
+            PROFILE_SCOPE(DoAction);
+            if (!ActionIsValid())
+                return false;
+#ifdef ALPHATANK_NETWORK
+            TankState before;
+            if (Network::ready)
+                before = *this;
+#endif
+
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    hasDestroyBlock[side][tank][currentTurn] = false;
+            // 这回合动过的坦克、坦克占用变了的格子、消失的地形，给 _updateThreats 用
+            bool moved[sideCount][tankPerSide] = {};
+            Bitboard occupied, terrain;
+            // 1 移动
             for (int side = 0; side < sideCount; side++)
                 for (int tank = 0; tank < tankPerSide; tank++) {
                     Action act = nextAction[side][tank];
@@ -389,7 +1317,7 @@ namespace TankGame {
                     // 保存动作
                     previousActions[currentTurn][side][tank] = act;
                     if (tankAlive[side][tank] && ActionIsMove(act)) {
-                        int &x = tankX[side][tank], &y = tankY[side][tank];
+                        signed char &x = tankX[side][tank], &y = tankY[side][tank];
                         FieldItem &items = gameField[y][x];
 
                         // 记录 Log
@@ -403,6 +1331,9 @@ namespace TankGame {
                         // 变更坐标
                         x += dx[act];
                         y += dy[act];
+                        moved[side][tank] = true;
+                        occupied.Set(log.x, log.y);
+                        occupied.Set(x, y);
 
                         // 更换标记（注意格子可能有多个坦克）
                         gameField[y][x] |= log.item;
@@ -419,39 +1350,37 @@ namespace TankGame {
                         int dir = ExtractDirectionFromAction(act);
                         int x = tankX[side][tank], y = tankY[side][tank];
                         bool hasMultipleTankWithMe = HasMultipleTank(gameField[y][x]);
-                        while (true) {
-                            x += dx[dir];
-                            y += dy[dir];
-                            if (!CoordValid(x, y))break;
-                            FieldItem items = gameField[y][x];
-                            if (items != None && items != Water) {
-                                // 对射判断
-                                if (items >= Blue0 &&
-                                    !hasMultipleTankWithMe && !HasMultipleTank(items)) {
-                                    // 自己这里和射到的目标格子都只有一个坦克
-                                    Action theirAction = nextAction[GetTankSide(items)][GetTankID(items)];
-                                    if (ActionIsShoot(theirAction) &&
-                                        ActionDirectionIsOpposite(act, theirAction)) {
-                                        // 而且我方和对方的射击方向是反的
-                                        // 那么就忽视这次射击
-                                        break;
-                                    }
-                                }
-
-                                // 标记这些物件要被摧毁了（防止重复摧毁）
-                                for (int mask = 1; mask <= Red1; mask <<= 1)
-                                    if (items & mask) {
-                                        hasDestroyBlock[side][tank][currentTurn] = true;
-                                        DisappearLog log;
-                                        log.x = x;
-                                        log.y = y;
-                                        log.item = (FieldItem) mask;
-                                        log.turn = currentTurn;
-                                        itemsToBeDestroyed.insert(log);
-                                    }
-                                break;
+                        int range = _shotRange(x, y, dir);
+                        x += dx[dir] * range;
+                        y += dy[dir] * range;
+                        if (!CoordValid(x, y))
+                            continue;
+                        FieldItem items = gameField[y][x];
+
+                        // 对射判断
+                        if (items >= Blue0 &&
+                            !hasMultipleTankWithMe && !HasMultipleTank(items)) {
+                            // 自己这里和射到的目标格子都只有一个坦克
+                            Action theirAction = nextAction[GetTankSide(items)][GetTankID(items)];
+                            if (ActionIsShoot(theirAction) &&
+                                ActionDirectionIsOpposite(act, theirAction)) {
+                                // 而且我方和对方的射击方向是反的
+                                // 那么就忽视这次射击
+                                continue;
                             }
                         }
+
+                        // 标记这些物件要被摧毁了（防止重复摧毁）
+                        for (int mask = 1; mask <= Red1; mask <<= 1)
+                            if (items & mask) {
+                                hasDestroyBlock[side][tank][currentTurn] = true;
+                                DisappearLog log;
+                                log.x = x;
+                                log.y = y;
+                                log.item = (FieldItem) mask;
+                                log.turn = currentTurn;
+                                itemsToBeDestroyed.insert(log);
+                            }
                     }
                 }
 
@@ -464,21 +1393,32 @@ namespace TankGame {
                     }
                     case Blue0:
                         _destroyTank(Blue, 0);
+                        moved[Blue][0] = true;
                         break;
                     case Blue1:
                         _destroyTank(Blue, 1);
+                        moved[Blue][1] = true;
                         break;
                     case Red0:
                         _destroyTank(Red, 0);
+                        moved[Red][0] = true;
                         break;
                     case Red1:
                         _destroyTank(Red, 1);
+                        moved[Red][1] = true;
                         break;
                     case Steel:
                         continue;
                     default:;
                 }
                 gameField[log.y][log.x] &= ~log.item;
+                if (log.item >= Blue0)
+                    occupied.Set(log.x, log.y);
+                if (log.item == Brick || log.item == Base) {
+                    terrain.Set(log.x, log.y);
+                    _toggleTerrain(log.x, log.y);
+                    _updateRays(log.x, log.y);
+                }
                 logs.push(log);
             }
 
@@ -486,23 +1426,25 @@ namespace TankGame {
                 for (int tank = 0; tank < tankPerSide; tank++)
                     nextAction[side][tank] = Invalid;
 
-            for (int side = 0; side < sideCount; side++)
-                for (int tank = 0; tank < tankPerSide; tank++)
-                    hasInit[side][tank] = false;
-
+            _recordPattern();
+            _updateThreats(moved, occupied, terrain);
+#ifdef ALPHATANK_NETWORK
+            if (Network::ready)
+                _updateAccumulator(before);
+#endif
+            ++version;
             currentTurn++;
             return true;
         }
 
         // 回到上一回合
         bool Revert() {
+            PROFILE_SCOPE(Revert);
             if (currentTurn == 1)
                 return false;
 
             currentTurn--;
-            for (int side = 0; side < sideCount; side++)
-                for (int tank = 0; tank < tankPerSide; tank++)
-                    hasInit[side][tank] = false;
+            ++version;
             while (!logs.empty()) {
                 DisappearLog &log = logs.top();
                 if (log.turn == currentTurn) {
@@ -512,10 +1454,14 @@ namespace TankGame {
                             int side = log.x == baseX[Blue] && log.y == baseY[Blue] ? Blue : Red;
                             baseAlive[side] = true;
                             gameField[log.y][log.x] = Base;
+                            _toggleTerrain(log.x, log.y);
+                            _updateRays(log.x, log.y);
                             break;
                         }
                         case Brick:
                             gameField[log.y][log.x] = Brick;
+                            _toggleTerrain(log.x, log.y);
+                            _updateRays(log.x, log.y);
                             break;
                         case Blue0:
                             _revertTank(Blue, 0, log);
@@ -537,6 +1483,52 @@ namespace TankGame {
             return true;
         }
 
+#ifdef ALPHATANK_NETWORK
+        // 局面在 perspective 视角下的激活特征，返回个数
+        int NetworkFeatures(int perspective, int out[]) const {
+            int n = 0;
+            for (int y = 0; y < fieldHeight; y++)
+                for (int x = 0; x < fieldWidth; x++) {
+                    FieldItem item = gameField[y][x];
+                    if (item & Brick)out[n++] = Network::CellFeature(perspective, Network::BrickPlane, x, y);
+                    if (item & Steel)out[n++] = Network::CellFeature(perspective, Network::SteelPlane, x, y);
+                    if (item & Water)out[n++] = Network::CellFeature(perspective, Network::WaterPlane, x, y);
+                }
+            for (int side = 0; side < sideCount; side++) {
+                if (baseAlive[side])
+                    out[n++] = Network::BaseFeature(perspective, side);
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    if (!tankAlive[side][tank])continue;
+                    out[n++] = Network::TankFeature(perspective, side, tank, tankX[side][tank], tankY[side][tank]);
+                    if (previousActions[currentTurn - 1][side][tank] > Left)
+                        out[n++] = Network::ShotFeature(perspective, side, tank);
+                }
+            }
+            return n;
+        }
+
+        // 从头算出当前回合的累加器；加载权重以后调用一次，之后由 DoAction 增量维护
+        void RefreshAccumulator() {
+            int active[Network::features];
+            for (int p = 0; p < sideCount; p++)
+                Network::Accumulate(active, NetworkFeatures(p, active), accumulator[currentTurn][p]);
+        }
+#endif
+
+        // 整个局面的 Zobrist 哈希：砖块和基地、存活坦克的位置、上回合是否射击
+        // 不含回合编号，同一深度的局面回合相同
+        unsigned long long Hash() const {
+            unsigned long long hash = terrainHash;
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    if (tankAlive[side][tank]) {
+                        hash ^= Zobrist::tank[side][tank][tankY[side][tank]][tankX[side][tank]];
+                        if (previousActions[currentTurn - 1][side][tank] > Left)
+                            hash ^= Zobrist::justShot[side][tank];
+                    }
+            return hash;
+        }
+
         // 游戏是否结束？谁赢了？
         GameResult GetGameResult() {
             bool fail[sideCount] = {};
@@ -544,7 +1536,7 @@ namespace TankGame {
                 if ((!tankAlive[side][0] && !tankAlive[side][1]) || !baseAlive[side])
                     fail[side] = true;
             if (fail[0] == fail[1])
-                return fail[0] || currentTurn > 105 ? Draw : NotFinished; // TODO: why 105 ???
+                return fail[0] || currentTurn > drawTurn ? Draw : NotFinished;
             if (fail[Blue])
                 return Red;
             return Blue;
@@ -555,16 +1547,16 @@ namespace TankGame {
             if (!baseAlive[0])return Red;
             if (!baseAlive[1])return Blue;
             if (!tankAlive[side][tank])return (GameResult) !side;
-            return currentTurn > 105 ? Draw : NotFinished;
+            return currentTurn > drawTurn ? Draw : NotFinished;
         }
 
-        // 三个 int 表示场地 01 矩阵（每个 int 用 27 位表示 3 行）
+        // mapWords 个 int 表示场地 01 矩阵（每个 int 表示 mapRowsPerWord 行，9x9 时是 27 位 3 行）
         // why only hasBrick
-        TankField(int hasBrick[3], int hasWater[3], int hasSteel[3], int mySide) : mySide(mySide) {
+        TankField(int hasBrick[mapWords], int hasWater[mapWords], int hasSteel[mapWords], int mySide) : mySide(mySide) {
 //        TankField(int hasBrick[3], int mySide) : mySide(mySide) {
-            for (int i = 0; i < 3; i++) {
+            for (int i = 0; i < mapWords; i++) {
                 int mask = 1;
-                for (int y = i * 3; y < (i + 1) * 3; y++) {
+                for (int y = i * mapRowsPerWord; y < min((i + 1) * mapRowsPerWord, fieldHeight); y++) {
                     for (int x = 0; x < fieldWidth; x++) {
                         if (hasBrick[i] & mask)
                             gameField[y][x] = Brick;
@@ -581,6 +1573,25 @@ namespace TankGame {
                     gameField[tankY[side][tank]][tankX[side][tank]] = tankItemTypes[side][tank];
                 gameField[baseY[side]][baseX[side]] = Base;
             }
+            for (int y = 0; y < fieldHeight; y++)
+                for (int x = 0; x < fieldWidth; x++)
+                    if (gameField[y][x] & (Brick | Base))
+                        _toggleTerrain(x, y);
+            // 场地不一定是方的：每行算一次左右射线，每列算一次上下射线
+            for (int y = 0; y < fieldHeight; y++)
+                _updateRays(0, y);
+            for (int x = 0; x < fieldWidth; x++)
+                _updateRays(x, 0);
+            RefreshThreats();
+        }
+
+        // 第 currentTurn 回合所有坦克的威胁图全部作废，查询时重算
+        void RefreshThreats() {
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    fireLines[currentTurn][side][tank] = threatNext[currentTurn][side][tank] = Bitboard();
+                    threatStale[currentTurn][side][tank] = tankAlive[side][tank] ? 3 : 0;
+                }
         }
 
         // 打印场地
@@ -639,7 +1650,7 @@ namespace TankGame {
                     cout << ", 坦克" << tank << boolean2String[tankAlive[side][tank]];
                 cout << endl;
             }
-            cout << "当前回合：" << currentTurn << "，";
+            cout << "当前回合：" << (int) currentTurn << "，";
             GameResult result = GetGameResult();
             if (result == -2)
                 cout << "游戏尚未结束" << endl;
@@ -682,13 +1693,18 @@ namespace TankGame {
             return previousActions[currentTurn - 1][side][tank] > Left;
         }
 
+        // 两点之间（不含两端）没有挡子弹的地形；有一端在场地内时查 firstBlock，否则逐格扫描
         bool CanShootEachOther(int x1, int y1, int x2, int y2) {
             if (x1 == x2) {
                 if (y1 > y2)std::swap(y1, y2);
+                if (CoordValid(x1, y1))return firstBlock[Down][y1][x1] >= y2 - y1;
+                if (CoordValid(x2, y2))return firstBlock[Up][y2][x2] >= y2 - y1;
                 for (int i = y1 + 1; i < y2; ++i)if (gameField[i][x1] & 7)return false;
                 return true;
             } else if (y1 == y2) {
                 if (x1 > x2)std::swap(x1, x2);
+                if (CoordValid(x1, y1))return firstBlock[Right][y1][x1] >= x2 - x1;
+                if (CoordValid(x2, y2))return firstBlock[Left][y2][x2] >= x2 - x1;
                 for (int i = x1 + 1; i < x2; ++i)if (gameField[y1][i] & 7)return false;
                 return true;
             }
@@ -706,38 +1722,94 @@ namespace TankGame {
             return CanShootEachOther(tankX[side][tank], tankY[side][tank], tankX[!side][!tank], tankY[!side][!tank]);
         }
 
+        // 从 (x, y) 向四个方向射击能打到的格子，到第一个挡子弹的地形为止（含该地形）
+        // 和 CanShootEachOther 一样不考虑坦克挡子弹
+        Bitboard FireLines(int x, int y) {
+            Bitboard lines;
+            for (int dir = 0; dir < 4; ++dir) {
+                int k = firstBlock[dir][y][x], bx = x + dx[dir] * k, by = y + dy[dir] * k;
+                lines |= CoordValid(bx, by) ? Rays::full[dir][y][x].Without(Rays::full[dir][by][bx])
+                                            : Rays::full[dir][y][x];
+            }
+            return lines;
+        }
+
+        // 坦克所在格的 FireLines，不管上回合是否射击过；已死为空
+        const Bitboard &TankLines(int side, int tank) {
+            unsigned char &stale = threatStale[currentTurn][side][tank];
+            if (stale & 1) {
+                fireLines[currentTurn][side][tank] = FireLines(tankX[side][tank], tankY[side][tank]);
+                stale &= ~1;
+            }
+            return fireLines[currentTurn][side][tank];
+        }
+
+        // 坦克本回合能打到的格子；已死或上回合射击过则为空
+        const Bitboard &ThreatNow(int side, int tank) {
+            static const Bitboard none;
+            return JustShoot(side, tank) ? none : TankLines(side, tank);
+        }
+
+        // 坦克本回合不射击（原地或移动一步）时，下回合能打到的格子
+        const Bitboard &ThreatNext(int side, int tank) {
+            unsigned char &stale = threatStale[currentTurn][side][tank];
+            if (stale & 2) {
+                threatNext[currentTurn][side][tank] = _nextThreat(side, tank, TankLines(side, tank));
+                stale &= ~2;
+            }
+            return threatNext[currentTurn][side][tank];
+        }
+
         bool CrossShoot(int side, int tank) {
-            if (CanShootEachOther(tankX[side][tank], tankY[side][tank], baseX[!side], baseY[!side]) &&
-                !JustShoot(side, tank))
+            PROFILE_SCOPE(CrossShoot);
+            if (ThreatNow(side, tank).Test(baseX[!side], baseY[!side]))
+                return false;
+            if (!tankAlive[side][tank])
                 return false;
-            if (CanTankShootEachOther(side, tank, !side, tank) && CanTankShootEachOther(side, tank, !side, !tank) &&
-                !JustShoot(!side, tank) && !JustShoot(!side, !tank)) {
-                return !(tankX[!side][tank] == tankX[!side][!tank] || tankY[!side][tank] == tankY[!side][!tank]);
+            int x = tankX[side][tank], y = tankY[side][tank];
+            for (int other = 0; other < tankPerSide; ++other) {
+                // 和我重叠的敌方坦克也算作能打到我（沿用 CanShootEachOther 的判断）
+                bool stacked = tankX[!side][other] == x && tankY[!side][other] == y && !JustShoot(!side, other);
+                if (!ThreatNow(!side, other).Test(x, y) && !stacked)
+                    return false;
             }
-            return false;
+            return !(tankX[!side][tank] == tankX[!side][!tank] || tankY[!side][tank] == tankY[!side][!tank]);
         }
 
+        // 只有这两个坦克行动、其余原地不动时，(side2, tank2) 会不会被 (side1, tank1) 打掉
+        // 目标落在射击方向的射线和威胁图上，再排除中间别的坦克挡住子弹和一对一的对射抵消
         bool WillKill(int side1, int tank1, Action act1, int side2, int tank2, Action act2) {
-            for (int i = 0; i < 2; ++i)for (int j = 0; j < 2; ++j)nextAction[i][j] = Stay;
-            nextAction[side1][tank1] = act1;
-            nextAction[side2][tank2] = act2;
-            DoAction();
-            bool flag = !tankAlive[side2][tank2];
-            Revert();
-            return flag;
+            if (!ActionIsValid(side1, tank1, act1) || !ActionIsValid(side2, tank2, act2))
+                return false;
+            if (!tankAlive[side2][tank2])
+                return true;
+            if (!ActionIsShoot(act1))
+                return false;
+            int d = act1 - 4, x = tankX[side1][tank1], y = tankY[side1][tank1];
+            int tx = tankX[side2][tank2], ty = tankY[side2][tank2];
+            if (ActionIsMove(act2))
+                tx += dx[act2], ty += dy[act2];
+            if (!(TankLines(side1, tank1) & Rays::full[d][y][x]).Test(tx, ty))
+                return false;
+            int k = (tx - x) * dx[d] + (ty - y) * dy[d];
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    if (!tankAlive[side][tank] || (side == side2 && tank == tank2))continue;
+                    int ox = tankX[side][tank] - x, oy = tankY[side][tank] - y, j = ox * dx[d] + oy * dy[d];
+                    if (j > 0 && j < k && ox == j * dx[d] && oy == j * dy[d])
+                        return false;
+                }
+            // 射击时目标没有移动，两个格子的坦克数就是现在的
+            return !(ActionIsShoot(act2) && ActionDirectionIsOpposite(act1, act2) &&
+                     !HasMultipleTank(gameField[y][x]) && !HasMultipleTank(gameField[ty][tx]));
         }
 
+        // 目标在 act 方向的射线上，且不比第一个挡子弹的地形远（打到地形本身也算）
+        // 用 TankLines 而不是 ThreatNow：只看几何，不管上回合是否射击过
         bool MayShooting(int side, int tank, Action act, int tarX, int tarY) {
-            if (!ActionIsShoot(act))return false;
-            int d = act - 4;
-            int x = tankX[side][tank] + dx[d], y = tankY[side][tank] + dy[d];
-            while (CoordValid(x, y)) {
-                if (x == tarX && y == tarY)return true;
-                if (gameField[y][x] & 7)break;
-                x += dx[d];
-                y += dy[d];
-            }
-            return false;
+            if (!ActionIsShoot(act) || !tankAlive[side][tank])return false;
+            return (TankLines(side, tank) & Rays::full[act - 4][tankY[side][tank]][tankX[side][tank]])
+                    .Test(tarX, tarY);
         }
 
         bool MayKill(int side1, int tank1, Action act1, int side2, int tank2, Action act2) {
@@ -757,29 +1829,24 @@ namespace TankGame {
             return x1 == x2 && y1 == y2;
         }
 
-        bool IsLink(int x1, int y1, int x2, int y2) {
-            return Utility::IsLink(x1, y1, x2, y2, gameField);
+        bool IsLink(Workspace &work, int x1, int y1, int x2, int y2) {
+            return Utility::IsLink(work.scratch, x1, y1, x2, y2, gameField);
         }
 
-        bool IsTankLink(int side1, int tank1, int side2, int tank2) {
-            return IsLink(tankX[side1][tank1], tankY[side1][tank1], tankX[side2][tank2], tankY[side2][tank2]);
+        bool IsTankLink(Workspace &work, int side1, int tank1, int side2, int tank2) {
+            return IsLink(work, tankX[side1][tank1], tankY[side1][tank1], tankX[side2][tank2], tankY[side2][tank2]);
         }
 
-        bool OneSide() {
-            return !IsTankLink(mySide, 0, mySide, 1) && !IsTankLink(mySide, 0, !mySide, 0) &&
-                   !IsTankLink(mySide, 1, !mySide, 1);
+        bool OneSide(Workspace &work) {
+            return !IsTankLink(work, mySide, 0, mySide, 1) && !IsTankLink(work, mySide, 0, !mySide, 0) &&
+                   !IsTankLink(work, mySide, 1, !mySide, 1);
         }
 
-        int dis[sideCount][tankPerSide][fieldHeight][fieldWidth]{0};
-        int attackDis[sideCount][tankPerSide]{0};
-        bool goodPath[sideCount][tankPerSide][fieldHeight][fieldWidth]{false};
-        bool goodDir[sideCount][tankPerSide][fieldHeight][fieldWidth][4]{false};
-        bool hasInit[sideCount][tankPerSide];
-
 //  TODO: need revisement due to water
-        void InitDistance(int side, int tank) {
-            if (hasInit[side][tank])return;
-            hasInit[side][tank] = true;
+        void InitDistance(Workspace &work, int side, int tank) {
+            if (work.cache.stamp[side][tank] == version)return;
+            PROFILE_SCOPE(InitDistance);
+            work.cache.stamp[side][tank] = version;
             int tmp = tankY[!side][!tank] + dy[Forward(!side)];
 //            if (tankAlive[!side][!tank]) {
 //                if (IsTankLink(side, tank, !side, !tank) && !WillCounter(side, tank)) {
@@ -790,94 +1857,58 @@ namespace TankGame {
 //                for (int i = tankY[!side][!tank] + dy[Forward(!side)]; i != tmp; i += dy[Forward(!side)])
 //                    gameField[i][tankX[!side][!tank]] = Steel;
 //            }
-            Utility::BFSDistance(tankX[side][tank], tankY[side][tank], gameField, dis[side][tank]);
+            if (!Utility::DistanceCache::Lookup(terrainHash, mirrorHash, tankX[side][tank], tankY[side][tank],
+                                                work.cache.dis[side][tank])) {
+                Utility::BFSDistance(work.scratch, tankX[side][tank], tankY[side][tank], gameField, work.cache.dis[side][tank]);
+                Utility::DistanceCache::Store(terrainHash, mirrorHash, tankX[side][tank], tankY[side][tank],
+                                              work.cache.dis[side][tank]);
+            }
 //            if (tankAlive[!side][!tank]) {
 //                for (int i = tankY[!side][!tank] + dy[Forward(!side)]; i != tmp; i += dy[Forward(!side)])
 //                    gameField[i][tankX[!side][!tank]] = None;
 //            }
-            int ret = (int) 1e9;
-            if ((side ^ tank) == 0) {
-                for (int tx = baseX[!side] - 1, det = 0; tx >= 0; --tx) {
-                    if (dis[side][tank][baseY[!side]][tx] + det < ret)ret = dis[side][tank][baseY[!side]][tx] + det;
-                    if (gameField[baseY[!side]][tx] & Brick)det += 2;
-                    if (gameField[baseY[!side]][tx] & Steel)det = (int) 1e9;
-                }
-            } else {
-                for (int tx = baseX[!side] + 1, det = 0; tx < fieldWidth; ++tx) {
-                    if (dis[side][tank][baseY[!side]][tx] + det < ret)ret = dis[side][tank][baseY[!side]][tx] + det;
-                    if (gameField[baseY[!side]][tx] & Brick)det += 2;
-                    if (gameField[baseY[!side]][tx] & Steel)det = (int) 1e9;
+            // goodPath：允许的开火位置中，走过去加上打穿中间砖块用时最少的那些格子
+            int flanks = AttackFlanks(side, tank), best = (int) 1e9;
+            int cost[fieldHeight][fieldWidth];
+            for (int y = 0; y < fieldHeight; ++y)
+                for (int x = 0; x < fieldWidth; ++x) {
+                    int bricks = Race::BricksToBase(gameField, x, y, !side, flanks);
+                    cost[y][x] = bricks < 0 ? (int) 1e9 : work.cache.dis[side][tank][y][x] + 2 * bricks;
+                    best = min(best, cost[y][x]);
                 }
-            }
-            int dty = dy[Forward(side)];
-            for (int ty = baseY[!side] - dty, det = 0; (gameField[baseX[!side]][ty] & Steel) == 0; ty -= dty) {
-                if (dis[side][tank][ty][baseX[!side]] + det < ret)ret = dis[side][tank][ty][baseX[!side]] + det;
-                if (gameField[ty][baseX[!side]] & Brick)det += 2;
-                if (gameField[ty][baseX[!side]] & Steel)det = (int) 1e9;
-            }
-            attackDis[side][tank] = ret + 1 + (tankY[side][tank] == baseY[!side] && JustShoot(side, tank));
-            for (int i = 0; i < fieldHeight; ++i)for (int j = 0; j < fieldWidth; ++j)goodPath[side][tank][i][j] = false;
-            if ((side ^ tank) == 0) {
-                for (int tx = baseX[!side] - 1, det = 0; tx >= 0; --tx) {
-                    if (dis[side][tank][baseY[!side]][tx] + det == ret)goodPath[side][tank][baseY[!side]][tx] = true;
-                    if (gameField[baseY[!side]][tx] & Brick)det += 2;
-                    if (gameField[baseY[!side]][tx] & Steel)det = (int) 1e9;
-                }
-            } else {
-                for (int tx = baseX[!side] + 1, det = 0; tx < fieldWidth; ++tx) {
-                    if (dis[side][tank][baseY[!side]][tx] + det == ret)goodPath[side][tank][baseY[!side]][tx] = true;
-                    if (gameField[baseY[!side]][tx] & Brick)det += 2;
-                    if (gameField[baseY[!side]][tx] & Steel)det = (int) 1e9;
-                }
-            }
-            for (int ty = baseY[!side] - dty, det = 0; (gameField[baseX[!side]][ty] & Steel) == 0; ty -= dty) {
-                if (dis[side][tank][ty][baseX[!side]] + det == ret)goodPath[side][tank][ty][baseX[!side]] = true;
-                if (gameField[ty][baseX[!side]] & Brick)det += 2;
-                if (gameField[ty][baseX[!side]] & Steel)det = (int) 1e9;
-            }
-            Utility::BFSBestPath(baseY[!side], gameField, dis[side][tank], goodPath[side][tank], goodDir[side][tank]);
+            for (int y = 0; y < fieldHeight; ++y)
+                for (int x = 0; x < fieldWidth; ++x)
+                    work.cache.goodPath[side][tank][y][x] = best < (int) 1e9 && cost[y][x] == best;
+            Utility::BFSBestPath(work.scratch, baseY[!side], gameField, work.cache.dis[side][tank], work.cache.goodPath[side][tank], work.cache.goodDir[side][tank]);
         }
 
-        void AnotherDistance(int side, int tank) {
-            int ret = (int) 1e9;
-            if (side ^ tank) {
-                for (int tx = baseX[!side] - 1, det = 0; tx >= 0; --tx) {
-                    if (dis[side][tank][baseY[!side]][tx] + det < ret)ret = dis[side][tank][baseY[!side]][tx] + det;
-                    if (gameField[baseY[!side]][tx] & Brick)det += 2;
-                    if (gameField[baseY[!side]][tx] & Steel)det = (int) 1e9;
-                }
-            } else {
-                for (int tx = baseX[!side] + 1, det = 0; tx < fieldWidth; ++tx) {
-                    if (dis[side][tank][baseY[!side]][tx] + det < ret)ret = dis[side][tank][baseY[!side]][tx] + det;
-                    if (gameField[baseY[!side]][tx] & Brick)det += 2;
-                    if (gameField[baseY[!side]][tx] & Steel)det = (int) 1e9;
-                }
-            }
-            attackDis[side][tank] = min(attackDis[side][tank], ret + 1);
+        // 进攻基地的方位：(side ^ tank) == 0 的坦克走基地左侧，另一个走右侧，都可以从基地正前方进攻
+        // 估值按这个分工调过参数，放开整列会让两个坦克都去抢中路
+        int AttackFlanks(int side, int tank) {
+            return ((side ^ tank) == 0 ? Race::LeftFlank : Race::RightFlank) | Race::Front;
+        }
+
+        // 不受干扰时打掉对方基地要几回合的上界（启发式，见 Race），坦克已死或打不到为 Race::unreachable
+        int RaceBound(Workspace &work, int side, int tank) {
+            if (!tankAlive[side][tank])return Race::unreachable;
+            return work.races.Bound(terrainHash, mirrorHash, gameField, !side, AttackFlanks(side, tank),
+                                    tankX[side][tank], tankY[side][tank], JustShoot(side, tank));
         }
 
-        bool Defensible(int side, int tank) {
+        bool Defensible(Workspace &work, int side, int tank) {
             if (!baseAlive[side])return false;
             if (!tankAlive[side][tank])return false;
             if (!tankAlive[!side][!tank])return true;
-            InitDistance(side, tank);
-            InitDistance(!side, !tank);
-            if ((side ^ tank) == 0) {
-                for (int x = baseX[side] - 1, det = 0, mn = (int) 1e9; x >= 0; --x) {
-                    if (mn > dis[!side][!tank][baseY[side]][x] + det &&
-                        dis[side][tank][baseY[side]][x] >= dis[!side][!tank][baseY[side]][x])
-                        return false;
-                    mn = min(mn, dis[side][tank][baseY[side]][x]);
-                    if (gameField[baseY[!side]][x] & Brick)det += 2;
-                }
-            } else {
-                for (int x = baseX[side] + 1, det = 0, mn = (int) 1e9; x <= fieldWidth; ++x) {
-                    if (mn > dis[!side][!tank][baseY[side]][x] + det &&
-                        dis[side][tank][baseY[side]][x] >= dis[!side][!tank][baseY[side]][x])
-                        return false;
-                    mn = min(mn, dis[side][tank][baseY[side]][x]);
-                    if (gameField[baseY[!side]][x] & Brick)det += 2;
-                }
+            InitDistance(work, side, tank);
+            InitDistance(work, !side, !tank);
+            // 沿着对方进攻我方基地的那一侧，从基地往外看对方能否先到
+            int step = (side ^ tank) == 0 ? -1 : 1, y = baseY[side];
+            for (int x = baseX[side] + step, det = 0, mn = (int) 1e9; CoordValid(x, y); x += step) {
+                if (mn > work.cache.dis[!side][!tank][y][x] + det &&
+                    work.cache.dis[side][tank][y][x] >= work.cache.dis[!side][!tank][y][x])
+                    return false;
+                mn = min(mn, work.cache.dis[side][tank][y][x]);
+                if (gameField[baseY[!side]][x] & Brick)det += 2;
             }
             if (tankY[side][tank] == baseY[side] && std::abs(tankX[side][tank] - baseX[side]) == 1) {
                 if (CanTankShootEachOther(side, tank) && JustShoot(side, tank) && !JustShoot(!side, !tank))return false;
@@ -895,13 +1926,13 @@ namespace TankGame {
             return getDirection(tankX[side][tank], tankY[side][tank], tankX[!side][!tank], tankY[!side][!tank]);
         }
 
-        int GetCorner(int side, int tank) {
+        int GetCorner(Workspace &work, int side, int tank) {
             int d = getDirection(!side, !tank);
             int x = tankX[side][tank], y = tankY[side][tank];
             int ret = 0;
             while (CoordValid(x, y)) {
                 for (int o = 0; o < 4; ++o) {
-                    if (goodDir[side][tank][y][x][o]) {
+                    if (work.cache.goodDir[side][tank][y][x][o]) {
                         int nx = x + dx[o], ny = y + dy[o];
                         if (CoordValid(nx, ny) && o != d) return ret;
                     }
@@ -922,8 +1953,12 @@ namespace TankGame {
             if (x_1 != x_2)return false;
             if (y_1 == y_2)return false;
             if (!CanShootEachOther(x_1, y_1, x_2, y_2))return false;
+            return CannotDodge(x_1, y_1, y_2);
+        }
+
+        // 同一列的两点之间，中间一格（或中间两格）都不能向左右躲开
+        bool CannotDodge(int x, int y_1, int y_2) {
             int y = (y_1 + y_2);
-            int x = x_1;
             int y1, y2;
             if (y & 1)y1 = y / 2, y2 = y / 2 + 1;
             else y1 = y / 2, y2 = y / 2;
@@ -933,9 +1968,13 @@ namespace TankGame {
             return true;
         }
 
+        // 两个对位的坦克同一列、能互相打到（查 TankLines），且中间躲不开
         bool IsCounter(int side, int tank) {
             if (JustShoot(side, tank) != JustShoot(!side, !tank))return false;
-            return IsCounter(tankX[side][tank], tankY[side][tank], tankX[!side][!tank], tankY[!side][!tank]);
+            if (!tankAlive[side][tank] || !tankAlive[!side][!tank])return false;
+            int x = tankX[side][tank], y = tankY[side][tank], oy = tankY[!side][!tank];
+            if (x != tankX[!side][!tank] || y == oy)return false;
+            return TankLines(side, tank).Test(x, oy) && CannotDodge(x, y, oy);
         }
 
         bool WillCounter(int side, int tank) {
@@ -943,13 +1982,15 @@ namespace TankGame {
             if (IsCounter(side, tank))return true;
             if (tankX[side][tank] == tankX[!side][!tank])return false;
             if (std::abs(tankX[side][tank] - tankX[!side][!tank]) > 1)return false;
-            if (CanShootEachOther(tankX[side][tank], tankY[side][tank], tankX[side][tank], tankY[!side][!tank]) &&
-                !JustShoot(side, tank)) {
+            // 同一行时两个坦克横向相邻，竖直方向上谈不上挡不挡；否则查本回合的威胁图
+            bool sameRow = tankY[side][tank] == tankY[!side][!tank];
+            if (!JustShoot(side, tank) &&
+                (sameRow || ThreatNow(side, tank).Test(tankX[side][tank], tankY[!side][!tank]))) {
                 return IsCounter(tankX[side][tank], tankY[side][tank] + dy[Forward(side)],
                                  tankX[side][tank], tankY[!side][!tank]);
             }
-            if (CanShootEachOther(tankX[!side][!tank], tankY[side][tank], tankX[!side][!tank], tankY[!side][!tank]) &&
-                !JustShoot(!side, !tank)) {
+            if (!JustShoot(!side, !tank) &&
+                (sameRow || ThreatNow(!side, !tank).Test(tankX[!side][!tank], tankY[side][tank]))) {
                 return IsCounter(tankX[!side][!tank], tankY[!side][!tank] + dy[Forward(!side)],
                                  tankX[side][!tank], tankY[side][tank]);
             }
@@ -957,13 +1998,11 @@ namespace TankGame {
         }
 
         bool inHome(int side, int tank) {
-            if (side == Blue)return tankY[side][tank] <= 3;
-            else return tankY[side][tank] >= 5;
+            return std::abs(tankY[side][tank] - baseY[side]) < halfDepth;
         }
 
         bool inEnemy(int side, int tank) {
-            if (side == Red)return tankY[side][tank] <= 3;
-            else return tankY[side][tank] >= 5;
+            return std::abs(tankY[side][tank] - baseY[!side]) < halfDepth;
         }
 
         bool BlocksBetween(int side, int tank) {
@@ -971,13 +2010,13 @@ namespace TankGame {
             if ((side ^ tank) == 0) {
                 ++x;
                 while (CoordValid(x, y) && x < tankX[side][!tank]) {
-                    if (gameField[y][x] == Brick && gameField[4][x] == Brick)return true;
+                    if (gameField[y][x] == Brick && gameField[midY][x] == Brick)return true;
                     ++x;
                 }
             } else {
                 --x;
                 while (CoordValid(x, y) && x > tankX[side][!tank]) {
-                    if (gameField[y][x] == Brick && gameField[4][x] == Brick)return true;
+                    if (gameField[y][x] == Brick && gameField[midY][x] == Brick)return true;
                     --x;
                 }
             }
@@ -985,24 +2024,22 @@ namespace TankGame {
         }
 
         bool IsDefensing(int side, int tank) {
-            int x, y;
-            if (side == Blue)y = 0; else y = fieldHeight - 1;
-            if (side ^ tank)x = 5; else x = 3;
+            int x = baseX[side] + ((side ^ tank) ? 1 : -1), y = baseY[side];
             return tankX[side][tank] == x && tankY[side][tank] == y;
         }
 
-        int EstimateAttack(int side, int tank) {
+        int EstimateAttack(Workspace &work, int side, int tank) {
             if (!tankAlive[side][tank])return (int) -1e8;
-            InitDistance(side, tank);
-            if (!tankAlive[!side][!tank])return (int) 1e8 - attackDis[side][tank];
-            InitDistance(!side, !tank);
+            int ours = RaceBound(work, side, tank);
+            if (!tankAlive[!side][!tank])return (int) 1e8 - ours;
+            int theirs = RaceBound(work, !side, !tank);
             if (!canDefense(side, tank)) {
-                return 500 * (attackDis[!side][!tank] - attackDis[side][tank]);
+                return 500 * (theirs - ours);
             }
 //            if (attackDis[side][tank] <= attackDis[!side][!tank])return 10 * (20 - attackDis[side][tank]);
 //            if (goodPath[!side][!tank][tankY[side][tank]][tankX[side][tank]])return -dis[!side][!tank][tankY[side][tank]][tankX[side][tank]];
 //            else return -100;
-            return 50 * (attackDis[!side][!tank] - attackDis[side][tank]) + 6 * (10 - attackDis[side][tank]);
+            return 50 * (theirs - ours) + 6 * (10 - ours);
 //            ret += BlocksBetween(!side, !tank) - BlocksBetween(side, tank);
 //            if (IsLink(tankX[side][tank], tankY[side][tank], tankX[!side][!tank], tankY[!side][!tank])) {
 //                if (VerticalDis(side, tank) <= 0 ||
@@ -1028,14 +2065,15 @@ namespace TankGame {
 //            return ret;
         }
 
-        int EstimateAttack(int side) {
-            return EstimateAttack(side, 0) + EstimateAttack(side, 1);
+        int EstimateAttack(Workspace &work, int side) {
+            return EstimateAttack(work, side, 0) + EstimateAttack(work, side, 1);
         }
 
+        // 坦克在己方半场的最前一行，且正前方是砖块
         bool inLine(int side, int tank) {
-            if (gameField[4][tankX[side][tank]] != Brick)return false;
-            if (side == Blue)return tankY[side][tank] == 3;
-            return tankY[side][tank] == 5;
+            int y = baseY[side] + (halfDepth - 1) * dy[Forward(side)];
+            if (gameField[y + dy[Forward(side)]][tankX[side][tank]] != Brick)return false;
+            return tankY[side][tank] == y;
         }
 
         pair<int, int> TempMove(Action act0) {
@@ -1055,148 +2093,998 @@ namespace TankGame {
             return TempMove(acts...) == make_pair(0, 0);
         }
 
+        // 最近 3 * cycle 回合里该方的动作以 cycle 为周期重复，且最近一个周期两个坦克都没有净位移，O(1)
+        bool SideInCycle(int side, int cycle) const {
+            int t = currentTurn - 1;
+            if (currentTurn <= 4 * cycle || repeatRun[cycle - 1][side][t] < 3 * cycle)return false;
+            for (int tank = 0; tank < tankPerSide; ++tank)
+                if (moveX[side][tank][t] != moveX[side][tank][t - cycle] ||
+                    moveY[side][tank][t] != moveY[side][tank][t - cycle])
+                    return false;
+            return true;
+        }
+
+        // 双方都在周期为 cycle 的循环里，且最近 4 * cycle 回合没有打到任何东西
+        bool InCycle(int cycle) const {
+            return lastDestroyTurn[currentTurn - 1] + 4 * cycle < currentTurn &&
+                   SideInCycle(Blue, cycle) && SideInCycle(Red, cycle);
+        }
+
+        // 局面处于循环中时，返回该坦克在循环里本回合对应的动作
         Action GetPattern(int side, int tank) {
-            for (int cycle = 1; cycle <= 8; ++cycle) {
-                if (currentTurn > 4 * cycle) {
-                    bool flag = true;
-                    for (int s = 0; s < 2; ++s) {
-                        for (int t = 0; t < 2; ++t) {
-                            for (int i = 1; i <= 4 * cycle; ++i)if (hasDestroyBlock[s][t][currentTurn - i])flag = false;
-                            for (int i = 1; i <= 4 * cycle - cycle; ++i) {
-                                if (previousActions[currentTurn - i][s][t] !=
-                                    previousActions[currentTurn - i - cycle][s][t])
-                                    flag = false;
-                            }
-                            int x = 0, y = 0;
-                            for (int i = 1; i <= cycle; ++i) {
-                                if (ActionIsMove(previousActions[currentTurn - i][s][t])) {
-                                    x += dx[previousActions[currentTurn - i][s][t]];
-                                    y += dy[previousActions[currentTurn - i][s][t]];
-                                }
-                            }
-                            if (x != 0 || y != 0)flag = false;
+            PROFILE_SCOPE(GetPattern);
+            for (int cycle = 1; cycle <= maxCycle; ++cycle)
+                if (InCycle(cycle))return previousActions[currentTurn - cycle][side][tank];
+            return Invalid;
+        }
+    };
+
+    TankField *field;
+
+    // 对手模型：统计对方是否按 GetPattern 预测的循环行动，跨回合通过 data 保存
+    struct OpponentModel {
+        // 已经统计到的回合
+        int observedTurn = 0;
+        int predicted[tankPerSide]{}, followed[tankPerSide]{};
+        // histogram[tank][act + 1]：对方各动作出现的次数
+        int histogram[tankPerSide][9]{};
+
+        // 在执行 f.nextAction 之前调用
+        void Observe(TankField &f) {
+            if (f.currentTurn <= observedTurn)return;
+            observedTurn = f.currentTurn;
+            int side = !f.mySide;
+            for (int tank = 0; tank < tankPerSide; ++tank) {
+                Action act = f.nextAction[side][tank];
+                if (act >= Stay && act <= LeftShoot)++histogram[tank][act + 1];
+                Action pattern = f.GetPattern(side, tank);
+                if (pattern == Invalid)continue;
+                ++predicted[tank];
+                if (pattern == act)++followed[tank];
+            }
+        }
+
+        // 对方多次偏离预测且偏离多于遵循时，搜索中不再假定它按循环行动
+        bool TrustPattern(int tank) const {
+            int missed = predicted[tank] - followed[tank];
+            return missed < 3 || followed[tank] >= missed;
+        }
+    } opponentModel;
+
+    // 一对一残局表：双方各剩一个坦克时，在当前地形上做逆向分析，得到谁能强制取胜以及几回合内
+    // 砖块按建表时的样子看作不会被打掉；不考虑回合上限，使用时自行判断
+    // 第一回合利用加倍的时间建好并通过 data 保存，砖块变化后到了一对一局面才重建
+    // 建表有时间预算，超时就放弃（这回合不用残局表）；压缩后超过 maxBytes 的表不保存
+    namespace Endgame {
+        // 状态：蓝方坦克的格子、红方坦克的格子、双方上回合是否射击
+        const int stateCount = cellCount * cellCount * 4;
+
+        // 走一步的结果：非负为下一个状态，否则是下面的终局
+        enum Outcome {
+            BlueWins = -1,
+            RedWins = -2,
+            BothLose = -3
+        };
+
+        // value[state]：n > 0 表示蓝方 n 回合内必胜，-n 表示红方 n 回合内必胜，0 表示双方都不能强制取胜
+        signed char value[stateCount];
+
+        // 存进 data 的残局表（压缩后）最多多少字节；data 每回合都要随输入传回来再解析
+        const size_t maxBytes = 32 * 1024;
+
+        // 建表时的地形哈希，与 TankField::terrainHash 相同才可以使用
+        // 与 mirrorHash 相同时局面是建表地形的旋转孪生，交换双方、旋转格子后查表
+        unsigned long long terrain = 0;
+        bool ready = false;
+
+        inline int StateIndex(int blue, int red, bool blueShot, bool redShot) {
+            return ((blue * cellCount + red) * 2 + blueShot) * 2 + redShot;
+        }
+
+        // 建表用的地形（不含坦克）
+        FieldItem ground[cellCount];
+
+        inline bool Standable(int cell) {
+            return ground[cell] == None;
+        }
+
+        // 一方坦克在 from，另一方在 other 时的合法动作
+        int Actions(int from, int other, bool justShot, Action out[9]) {
+            int n = 0;
+            out[n++] = Stay;
+            for (int dir = Up; dir <= Left; dir++) {
+                int to = geometry.step[from][dir];
+                if (to >= 0 && Standable(to) && to != other)
+                    out[n++] = (Action) dir;
+            }
+            if (!justShot)
+                for (int act = UpShoot; act <= LeftShoot; act++)
+                    out[n++] = (Action) act;
+            return n;
+        }
+
+        // 从 from 射击 target 方向 act 的结果：0 没打到，1 打到坦克，2 打到蓝方基地，3 打到红方基地
+        int Shoot(int from, int target, Action act, Action theirAct) {
+            int dir = ExtractDirectionFromAction(act);
+            for (int k = 0; k < geometry.rayLength[from][dir]; k++) {
+                int cell = geometry.ray[from][dir][k];
+                if (cell == target)
+                    // 两个格子上都只有一个坦克，反向对射则互相抵消
+                    return ActionIsShoot(theirAct) && ActionDirectionIsOpposite(act, theirAct) ? 0 : 1;
+                if (ground[cell] == Base)
+                    return cell == geometry.Cell(baseX[Blue], baseY[Blue]) ? 2 : 3;
+                if (ground[cell] & (Brick | Steel))
+                    return 0;
+            }
+            return 0;
+        }
+
+        int Step(int blue, int red, Action blueAct, Action redAct) {
+            if (ActionIsMove(blueAct))blue = geometry.step[blue][blueAct];
+            if (ActionIsMove(redAct))red = geometry.step[red][redAct];
+            bool lose[sideCount] = {};
+            int hits[sideCount] = {};
+            if (ActionIsShoot(blueAct))hits[Blue] = Shoot(blue, red, blueAct, redAct);
+            if (ActionIsShoot(redAct))hits[Red] = Shoot(red, blue, redAct, blueAct);
+            for (int side = 0; side < sideCount; side++) {
+                if (hits[side] == 1)lose[!side] = true;
+                if (hits[side] == 2)lose[Blue] = true;
+                if (hits[side] == 3)lose[Red] = true;
+            }
+            if (lose[Blue] && lose[Red])return BothLose;
+            if (lose[Blue])return RedWins;
+            if (lose[Red])return BlueWins;
+            return StateIndex(blue, red, ActionIsShoot(blueAct), ActionIsShoot(redAct));
+        }
+
+        // 过了 deadline 还没建完就放弃，返回 false，表不可用
+        bool Build(const TankField &f, std::chrono::steady_clock::time_point deadline) {
+            ready = false;
+            for (int y = 0; y < fieldHeight; y++)
+                for (int x = 0; x < fieldWidth; x++)
+                    ground[geometry.Cell(x, y)] = (FieldItem) (f.gameField[y][x] & (Brick | Steel | Base | Water));
+            memset(value, 0, sizeof(value));
+
+            // 先算出每个状态下所有联合动作的结果，之后按层迭代：
+            // 蓝方有一个动作，无论红方怎么走都直接获胜或进入已知的蓝方必胜状态，则该状态蓝方必胜，红方同理
+            struct Node {
+                int state, first;
+                unsigned char blueCount, redCount;
+            };
+            vector<Node> nodes;
+            vector<int> outcomes;
+            for (int blue = 0; blue < cellCount; blue++) {
+                if (!Standable(blue))continue;
+                if (std::chrono::steady_clock::now() > deadline)return false;
+                for (int red = 0; red < cellCount; red++) {
+                    if (!Standable(red))continue;
+                    for (int shot = 0; shot < 4; shot++) {
+                        Action blueActs[9], redActs[9];
+                        Node node;
+                        node.state = StateIndex(blue, red, shot >> 1, shot & 1);
+                        node.first = outcomes.size();
+                        node.blueCount = Actions(blue, red, shot >> 1, blueActs);
+                        node.redCount = Actions(red, blue, shot & 1, redActs);
+                        for (int i = 0; i < node.blueCount; i++)
+                            for (int j = 0; j < node.redCount; j++)
+                                outcomes.push_back(Step(blue, red, blueActs[i], redActs[j]));
+                        nodes.push_back(node);
+                    }
+                }
+            }
+
+            for (int depth = 1; depth <= 127; depth++) {
+                if (std::chrono::steady_clock::now() > deadline)return false;
+                bool changed = false;
+                for (auto &node : nodes) {
+                    if (value[node.state])continue;
+                    const int *o = &outcomes[node.first];
+                    int blueCount = node.blueCount, redCount = node.redCount;
+                    bool blueWins = false, redWins = false;
+                    for (int i = 0; i < blueCount && !blueWins; i++) {
+                        bool all = true;
+                        for (int j = 0; j < redCount && all; j++) {
+                            int r = o[i * redCount + j];
+                            all = r == BlueWins || (r >= 0 && value[r] > 0 && value[r] < depth);
+                        }
+                        blueWins = all;
+                    }
+                    for (int j = 0; j < redCount && !blueWins && !redWins; j++) {
+                        bool all = true;
+                        for (int i = 0; i < blueCount && all; i++) {
+                            int r = o[i * redCount + j];
+                            all = r == RedWins || (r >= 0 && value[r] < 0 && -value[r] < depth);
                         }
+                        redWins = all;
+                    }
+                    if (blueWins || redWins) {
+                        value[node.state] = (signed char) (blueWins ? depth : -depth);
+                        changed = true;
                     }
-                    if (flag)return previousActions[currentTurn - cycle][side][tank];
                 }
+                if (!changed)break;
             }
-            return Invalid;
+            terrain = f.terrainHash;
+            ready = true;
+            return true;
         }
-    };
 
-    TankField *field;
+        bool Ready(const TankField &f) {
+            return ready && (terrain == f.terrainHash || terrain == f.mirrorHash);
+        }
+
+        // 双方各只剩一个坦克
+        bool IsDuel(const TankField &f) {
+            return f.tankAlive[Blue][0] + f.tankAlive[Blue][1] == 1 && f.tankAlive[Red][0] + f.tankAlive[Red][1] == 1;
+        }
+
+        // 从 side 的角度查表：n > 0 表示 n 回合内必胜，-n 表示 n 回合内必败，0 表示无法强制或不是一对一
+        int Lookup(TankField &f, int side) {
+            if (!IsDuel(f) || !Ready(f) || !f.baseAlive[Blue] || !f.baseAlive[Red])return 0;
+            int blue = f.tankAlive[Blue][0] ? 0 : 1, red = f.tankAlive[Red][0] ? 0 : 1;
+            int blueCell = f.tankX[Blue][blue] + f.tankY[Blue][blue] * fieldWidth;
+            int redCell = f.tankX[Red][red] + f.tankY[Red][red] * fieldWidth;
+            if (terrain != f.terrainHash) {
+                // 旋转后格子编号 c 变成 cellCount - 1 - c，蓝方坦克成了红方坦克
+                int v = value[StateIndex(cellCount - 1 - redCell, cellCount - 1 - blueCell,
+                                         f.JustShoot(Red, red), f.JustShoot(Blue, blue))];
+                return side == Blue ? -v : v;
+            }
+            int v = value[StateIndex(blueCell, redCell, f.JustShoot(Blue, blue), f.JustShoot(Red, red))];
+            return side == Blue ? v : -v;
+        }
+    }
+
+#ifdef ALPHATANK_NETWORK
+    namespace Network {
+        // (side, tank) 对 (!side, !tank) 的估值，与 EstimateAttack 同一量纲，限制在 ±100000 以内
+        // 只算输出层，第一层用局面里增量维护的累加器
+        int Evaluate(const TankField &f, int side, int tank) {
+            const auto &acc = f.accumulator[f.currentTurn];
+            return max(-100000, min(100000, Output(acc[side], acc[!side], tank) / divisor));
+        }
+    }
+#endif
 
     // 内部函数
     namespace Internals {
-        Json::Reader reader;
-#ifdef _BOTZONE_ONLINE
-        Json::FastWriter writer;
-#else
-        Json::StyledWriter writer;
-#endif
+        void _processRequestOrResponse(const int act[tankPerSide], bool isOpponent) {
+            if (!isOpponent) {
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    field->nextAction[field->mySide][tank] = (Action) act[tank];
+            } else {
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    field->nextAction[1 - field->mySide][tank] = (Action) act[tank];
+                opponentModel.Observe(*field);
+                field->DoAction();
+            }
+        }
 
-        void _processRequestOrResponse(Json::Value &value, bool isOpponent) {
-            if (value.isArray()) {
-                if (!isOpponent) {
-                    for (int tank = 0; tank < tankPerSide; tank++)
-                        field->nextAction[field->mySide][tank] = (Action) value[tank].asInt();
+        // 一条 request：第一回合是场地描述，之后是对方上回合的动作
+        struct Request {
+            bool isField = false;
+            int act[tankPerSide] = {};
+            int hasBrick[mapWords] = {}, hasWater[mapWords] = {}, hasSteel[mapWords] = {};
+            int mySide = 0;
+        };
+
+        struct ProtocolInput {
+            vector<Request> requests;
+            vector<Request> responses;
+            string data, globaldata;
+            bool hasRequests = false;
+        };
+
+        // Botzone 坦克协议的流式解析器：直接从 streambuf 逐字符读取，把整数数组解码进 Request，
+        // 不构建 JSON DOM；读到最外层的值结束为止，不会多读后续输入
+        class ProtocolReader {
+            std::streambuf *buf;
+
+            int Peek() {
+                return buf->sgetc();
+            }
+
+            int Next() {
+                return buf->sbumpc();
+            }
+
+            void SkipSpace() {
+                while (Peek() == ' ' || Peek() == '\n' || Peek() == '\r' || Peek() == '\t')Next();
+            }
+
+            bool Expect(char c) {
+                SkipSpace();
+                if (Peek() != c)return false;
+                Next();
+                return true;
+            }
+
+            static void AppendUtf8(string &out, unsigned code) {
+                if (code < 0x80) {
+                    out += (char) code;
+                } else if (code < 0x800) {
+                    out += (char) (0xC0 | (code >> 6));
+                    out += (char) (0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    out += (char) (0xE0 | (code >> 12));
+                    out += (char) (0x80 | ((code >> 6) & 0x3F));
+                    out += (char) (0x80 | (code & 0x3F));
                 } else {
-                    for (int tank = 0; tank < tankPerSide; tank++)
-                        field->nextAction[1 - field->mySide][tank] = (Action) value[tank].asInt();
-                    field->DoAction();
+                    out += (char) (0xF0 | (code >> 18));
+                    out += (char) (0x80 | ((code >> 12) & 0x3F));
+                    out += (char) (0x80 | ((code >> 6) & 0x3F));
+                    out += (char) (0x80 | (code & 0x3F));
                 }
-            } else {
-                // 是第一回合，裁判在介绍场地
-                int hasBrick[3], hasWater[3], hasSteel[3];
-                for (int i = 0; i < 3; i++) {
-                    hasWater[i] = value["waterfield"][i].asInt();
-                    hasBrick[i] = value["brickfield"][i].asInt();
-                    hasSteel[i] = value["steelfield"][i].asInt();
+            }
+
+            bool ReadHex4(unsigned &code) {
+                code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    int c = Next();
+                    code <<= 4;
+                    if (c >= '0' && c <= '9')code |= c - '0';
+                    else if (c >= 'a' && c <= 'f')code |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F')code |= c - 'A' + 10;
+                    else return false;
+                }
+                return true;
+            }
+
+            // out 为空指针时只跳过字符串
+            bool ReadString(string *out) {
+                if (!Expect('"'))return false;
+                while (true) {
+                    int c = Next();
+                    if (c == EOF)return false;
+                    if (c == '"')return true;
+                    if (c != '\\') {
+                        if (out)*out += (char) c;
+                        continue;
+                    }
+                    c = Next();
+                    unsigned code;
+                    switch (c) {
+                        case '"':
+                        case '\\':
+                        case '/':
+                            break;
+                        case 'b':
+                            c = '\b';
+                            break;
+                        case 'f':
+                            c = '\f';
+                            break;
+                        case 'n':
+                            c = '\n';
+                            break;
+                        case 'r':
+                            c = '\r';
+                            break;
+                        case 't':
+                            c = '\t';
+                            break;
+                        case 'u':
+                            if (!ReadHex4(code))return false;
+                            if (code >= 0xD800 && code < 0xDC00) {
+                                unsigned low;
+                                if (Next() != '\\' || Next() != 'u' || !ReadHex4(low))return false;
+                                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            }
+                            if (out)AppendUtf8(*out, code);
+                            continue;
+                        default:
+                            return false;
+                    }
+                    if (out)*out += (char) c;
                 }
-                field = new TankField(hasBrick, hasWater, hasSteel, value["mySide"].asInt());
             }
+
+            // 小数部分和指数直接截断
+            bool ReadInt(int &x) {
+                SkipSpace();
+                bool negative = false;
+                if (Peek() == '-') {
+                    negative = true;
+                    Next();
+                }
+                if (Peek() < '0' || Peek() > '9')return false;
+                long long v = 0;
+                while (Peek() >= '0' && Peek() <= '9')v = v * 10 + (Next() - '0');
+                while (Peek() == '.' || Peek() == 'e' || Peek() == 'E' || Peek() == '+' || Peek() == '-' ||
+                       (Peek() >= '0' && Peek() <= '9'))
+                    Next();
+                x = (int) (negative ? -v : v);
+                return true;
+            }
+
+            bool SkipLiteral(const char *word) {
+                for (; *word; ++word)if (Next() != *word)return false;
+                return true;
+            }
+
+            bool SkipValue() {
+                SkipSpace();
+                int c = Peek();
+                if (c == '"')return ReadString(nullptr);
+                if (c == '{' || c == '[') {
+                    char close = c == '{' ? '}' : ']';
+                    Next();
+                    if (Expect(close))return true;
+                    do {
+                        if (c == '{' && (!ReadString(nullptr) || !Expect(':')))return false;
+                        if (!SkipValue())return false;
+                    } while (Expect(','));
+                    return Expect(close);
+                }
+                if (c == 't')return SkipLiteral("true");
+                if (c == 'f')return SkipLiteral("false");
+                if (c == 'n')return SkipLiteral("null");
+                int x;
+                return ReadInt(x);
+            }
+
+            // 读取整数数组的前 n 项，多余的项跳过，缺少的项保持原值
+            bool ReadIntArray(int *out, int n) {
+                if (!Expect('['))return false;
+                if (Expect(']'))return true;
+                int i = 0;
+                do {
+                    SkipSpace();
+                    if (i < n && Peek() != '"' && Peek() != '[' && Peek() != '{' && Peek() != 'n') {
+                        if (!ReadInt(out[i++]))return false;
+                    } else if (!SkipValue())return false;
+                } while (Expect(','));
+                return Expect(']');
+            }
+
+            // 对象中的一个键值对；既可能是场地描述的字段，也可能是最外层的 requests/responses/data/globaldata
+            bool ReadMember(const string &key, Request &request, ProtocolInput *input) {
+                if (key == "brickfield")return request.isField = true, ReadIntArray(request.hasBrick, mapWords);
+                if (key == "waterfield")return request.isField = true, ReadIntArray(request.hasWater, mapWords);
+                if (key == "steelfield")return request.isField = true, ReadIntArray(request.hasSteel, mapWords);
+                if (key == "mySide")return request.isField = true, ReadInt(request.mySide);
+                if (input) {
+                    if (key == "requests")return input->hasRequests = true, ReadRequests(input->requests);
+                    if (key == "responses")return ReadRequests(input->responses);
+                    if (key == "data")return ReadString(&input->data);
+                    if (key == "globaldata")return ReadString(&input->globaldata);
+                }
+                return SkipValue();
+            }
+
+            bool ReadRequest(Request &request, ProtocolInput *input = nullptr) {
+                SkipSpace();
+                if (Peek() == '[')return ReadIntArray(request.act, tankPerSide);
+                if (!Expect('{'))return SkipValue();
+                if (Expect('}'))return true;
+                string key;
+                do {
+                    key.clear();
+                    if (!ReadString(&key) || !Expect(':') || !ReadMember(key, request, input))return false;
+                } while (Expect(','));
+                return Expect('}');
+            }
+
+            bool ReadRequests(vector<Request> &out) {
+                if (!Expect('['))return SkipValue();
+                if (Expect(']'))return true;
+                do {
+                    out.emplace_back();
+                    if (!ReadRequest(out.back()))return false;
+                } while (Expect(','));
+                return Expect(']');
+            }
+
+        public:
+            explicit ProtocolReader(istream &in) : buf(in.rdbuf()) {}
+
+            // 最外层要么是带 requests 的对象，要么（长时运行时）直接是一条 request
+            bool Parse(ProtocolInput &input) {
+                Request top;
+                if (!ReadRequest(top, &input))return false;
+                if (!input.hasRequests) {
+                    input.requests.clear();
+                    input.requests.push_back(top);
+                }
+                return true;
+            }
+        };
+
+        void _processRequest(const Request &request) {
+            if (request.isField) {
+                // 是第一回合，裁判在介绍场地
+                int hasBrick[mapWords], hasWater[mapWords], hasSteel[mapWords];
+                memcpy(hasBrick, request.hasBrick, sizeof(hasBrick));
+                memcpy(hasWater, request.hasWater, sizeof(hasWater));
+                memcpy(hasSteel, request.hasSteel, sizeof(hasSteel));
+                field = new TankField(hasBrick, hasWater, hasSteel, request.mySide);
+            } else
+                _processRequestOrResponse(request.act, true);
         }
 
+        // 固定格式的回复输出：在栈上的缓冲区里拼好整条回复，通常只需要一次 write 系统调用
+        class ResponseWriter {
+            char buf[1 << 16];
+            size_t len = 0;
+
+        public:
+            void Flush() {
+                size_t done = 0;
+                while (done < len) {
+#ifdef _WIN32
+                    int ret = _write(1, buf + done, (unsigned) (len - done));
+#else
+                    ssize_t ret = write(1, buf + done, len - done);
+#endif
+                    if (ret <= 0)break;
+                    done += ret;
+                }
+                len = 0;
+            }
+
+            void Put(char c) {
+                if (len == sizeof(buf))Flush();
+                buf[len++] = c;
+            }
+
+            void Put(const char *s) {
+                while (*s)Put(*s++);
+            }
+
+            void PutInt(int x) {
+                char digits[12];
+                int n = 0;
+                unsigned v = x < 0 ? 0u - (unsigned) x : (unsigned) x;
+                do {
+                    digits[n++] = (char) ('0' + v % 10);
+                    v /= 10;
+                } while (v);
+                if (x < 0)Put('-');
+                while (n)Put(digits[--n]);
+            }
+
+            // 带转义的 JSON 字符串，非 ASCII 字节原样输出（UTF-8）
+            void PutString(const string &s) {
+                static const char hex[] = "0123456789abcdef";
+                Put('"');
+                for (unsigned char c : s) {
+                    switch (c) {
+                        case '"':
+                            Put("\\\"");
+                            break;
+                        case '\\':
+                            Put("\\\\");
+                            break;
+                        case '\b':
+                            Put("\\b");
+                            break;
+                        case '\f':
+                            Put("\\f");
+                            break;
+                        case '\n':
+                            Put("\\n");
+                            break;
+                        case '\r':
+                            Put("\\r");
+                            break;
+                        case '\t':
+                            Put("\\t");
+                            break;
+                        default:
+                            if (c < 0x20) {
+                                Put("\\u00");
+                                Put(hex[c >> 4]);
+                                Put(hex[c & 15]);
+                            } else
+                                Put((char) c);
+                    }
+                }
+                Put('"');
+            }
+
+            void PutMember(const char *key, const string &value) {
+                if (value.empty())return;
+                Put(",\"");
+                Put(key);
+                Put("\":");
+                PutString(value);
+            }
+        };
+
         // 请使用 SubmitAndExit 或者 SubmitAndDontExit
-        void _submitAction(Action tank0, Action tank1, string debug = "", string data = "", string globaldata = "") {
-            Json::Value output(Json::objectValue), response(Json::arrayValue);
-            response[0U] = tank0;
-            response[1U] = tank1;
-            output["response"] = response;
-            if (!debug.empty())
-                output["debug"] = debug;
-            if (!data.empty())
-                output["data"] = data;
-            if (!globaldata.empty())
-                output["globaldata"] = globaldata;
-            cout << writer.write(output) << endl;
+        void _submitAction(Action tank0, Action tank1, const string &debug = "", const string &data = "",
+                           const string &globaldata = "", bool keepRunning = false) {
+            // 本地调试时 DebugPrint 用的是 cout，先把它刷出去
+            cout << flush;
+            ResponseWriter writer;
+            writer.Put("{\"response\":[");
+            writer.PutInt(tank0);
+            writer.Put(',');
+            writer.PutInt(tank1);
+            writer.Put(']');
+            writer.PutMember("debug", debug);
+            writer.PutMember("data", data);
+            writer.PutMember("globaldata", globaldata);
+            writer.Put("}\n");
+            if (keepRunning)
+                writer.Put(">>>BOTZONE_REQUEST_KEEP_RUNNING<<<\n");
+            writer.Flush();
         }
     }
 
-    // 从输入流（例如 cin 或者 fstream）读取回合信息，存入 TankField，并提取上回合存储的 data 和 globaldata
-    // 本地调试的时候支持多行，但是最后一行需要以没有缩进的一个"}"或"]"结尾
-    void ReadInput(istream &in, string &outData, string &outGlobalData) {
-        Json::Value input;
-        string inputString;
-        do {
-            getline(in, inputString);
-        } while (inputString.empty());
-#ifndef _BOTZONE_ONLINE
-        // 猜测是单行还是多行
-        char lastChar = inputString[inputString.size() - 1];
-        if (lastChar != '}' && lastChar != ']') {
-            // 第一行不以}或]结尾，猜测是多行
-            string newString;
-            do {
-                getline(in, newString);
-                inputString += newString;
-            } while (newString != "}" && newString != "]");
+    // 跨回合保存的状态：二进制打包、base64 编码后放进 data，下回合在重放历史之前恢复
+    // 格式：版本号、地图签名，然后是若干 (标签, 长度, 内容) 段，不认识的段直接跳过
+    namespace Persistence {
+        const unsigned char version = 1;
+
+        enum Section {
+            DistanceTables = 1,
+            OpponentStatistics = 2,
+            EndgameTable = 3
+        };
+
+        // 每回合最多保存的距离表个数（只保存当前地形下的）
+        const int maxDistanceTables = 32;
+
+        const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        string Base64Encode(const string &bytes) {
+            string out;
+            out.reserve((bytes.size() + 2) / 3 * 4);
+            for (size_t i = 0; i < bytes.size(); i += 3) {
+                unsigned v = (unsigned char) bytes[i] << 16;
+                if (i + 1 < bytes.size())v |= (unsigned char) bytes[i + 1] << 8;
+                if (i + 2 < bytes.size())v |= (unsigned char) bytes[i + 2];
+                out += base64Chars[v >> 18];
+                out += base64Chars[(v >> 12) & 63];
+                out += i + 1 < bytes.size() ? base64Chars[(v >> 6) & 63] : '=';
+                out += i + 2 < bytes.size() ? base64Chars[v & 63] : '=';
+            }
+            return out;
         }
-#endif
-        Internals::reader.parse(inputString, input);
-
-        if (input.isObject()) {
-            Json::Value requests = input["requests"], responses = input["responses"];
-            if (!requests.isNull() && requests.isArray()) {
-                int i, n = requests.size();
-                for (i = 0; i < n; i++) {
-                    Internals::_processRequestOrResponse(requests[i], true);
-                    if (i < n - 1)
-                        Internals::_processRequestOrResponse(responses[i], false);
+
+        bool Base64Decode(const string &text, string &bytes) {
+            int value[256];
+            for (int &v : value)v = -1;
+            for (int i = 0; i < 64; ++i)value[(unsigned char) base64Chars[i]] = i;
+            unsigned acc = 0;
+            int bits = 0;
+            for (unsigned char c : text) {
+                if (c == '=')break;
+                if (value[c] < 0)return false;
+                acc = (acc << 6) | value[c];
+                bits += 6;
+                if (bits >= 8) {
+                    bits -= 8;
+                    bytes += (char) ((acc >> bits) & 255);
                 }
-                outData = input["data"].asString();
-                outGlobalData = input["globaldata"].asString();
-                return;
             }
+            return true;
+        }
+
+        class BlobWriter {
+            string bytes;
+            size_t sectionStart = 0;
+
+        public:
+            void PutByte(int v) {
+                bytes += (char) (unsigned char) v;
+            }
+
+            void PutInt(int v) {
+                for (int i = 0; i < 4; ++i)PutByte((unsigned) v >> (8 * i));
+            }
+
+            void PutLong(unsigned long long v) {
+                for (int i = 0; i < 8; ++i)PutByte((int) (v >> (8 * i)));
+            }
+
+            void PutBytes(const void *p, size_t n) {
+                bytes.append((const char *) p, n);
+            }
+
+            // 段长度在 EndSection 时回填
+            void BeginSection(Section tag) {
+                PutByte(tag);
+                sectionStart = bytes.size();
+                PutInt(0);
+            }
+
+            void EndSection() {
+                unsigned length = bytes.size() - sectionStart - 4;
+                for (int i = 0; i < 4; ++i)bytes[sectionStart + i] = (char) (length >> (8 * i));
+            }
+
+            const string &Bytes() const {
+                return bytes;
+            }
+        };
+
+        class BlobReader {
+            const string &bytes;
+            size_t pos = 0, end;
+
+        public:
+            bool ok = true;
+
+            explicit BlobReader(const string &bytes) : bytes(bytes), end(bytes.size()) {}
+
+            bool AtEnd() const {
+                return pos >= end;
+            }
+
+            int GetByte() {
+                if (pos >= end) {
+                    ok = false;
+                    return 0;
+                }
+                return (unsigned char) bytes[pos++];
+            }
+
+            int GetInt() {
+                unsigned v = 0;
+                for (int i = 0; i < 4; ++i)v |= (unsigned) GetByte() << (8 * i);
+                return (int) v;
+            }
+
+            unsigned long long GetLong() {
+                unsigned long long v = 0;
+                for (int i = 0; i < 8; ++i)v |= (unsigned long long) GetByte() << (8 * i);
+                return v;
+            }
+
+            void GetBytes(void *p, size_t n) {
+                if (pos + n > end) {
+                    ok = false;
+                    return;
+                }
+                memcpy(p, bytes.data() + pos, n);
+                pos += n;
+            }
+
+            // 进入一个段：返回标签，段内读取被限制在段长度内
+            int BeginSection(size_t &sectionEnd) {
+                end = bytes.size();
+                int tag = GetByte();
+                unsigned length = GetInt();
+                sectionEnd = pos + length;
+                if (!ok || sectionEnd > bytes.size())ok = false;
+                else end = sectionEnd;
+                return tag;
+            }
+
+            void EndSection(size_t sectionEnd) {
+                end = bytes.size();
+                pos = sectionEnd;
+            }
+        };
+
+        // 地图签名：第一回合的场地描述和我方编号，用来确认 data 属于当前这局
+        int signature[3 * mapWords + 1];
+
+        void SetSignature(const Internals::Request &first) {
+            for (int i = 0; i < mapWords; ++i) {
+                signature[i] = first.hasBrick[i];
+                signature[mapWords + i] = first.hasWater[i];
+                signature[2 * mapWords + i] = first.hasSteel[i];
+            }
+            signature[3 * mapWords] = first.mySide;
+        }
+
+        void LoadDistanceTables(BlobReader &in) {
+            int n = in.GetByte();
+            for (int i = 0; i < n && in.ok; ++i) {
+                unsigned long long terrain = in.GetLong();
+                int x = in.GetByte(), y = in.GetByte();
+                unsigned char dis[fieldHeight][fieldWidth];
+                in.GetBytes(dis, sizeof(dis));
+                if (!in.ok || !CoordValid(x, y))return;
+                auto &e = Utility::DistanceCache::Slot(terrain, x, y);
+                e.terrain = terrain;
+                e.x = x;
+                e.y = y;
+                e.used = true;
+                memcpy(e.dis, dis, sizeof(dis));
+            }
+        }
+
+        void SaveDistanceTables(BlobWriter &out) {
+            vector<const Utility::DistanceCache::Entry *> tables;
+            for (auto &e : Utility::DistanceCache::entries)
+                if (e.used && (e.terrain == field->terrainHash || e.terrain == field->mirrorHash) &&
+                    (int) tables.size() < maxDistanceTables)
+                    tables.push_back(&e);
+            out.PutByte(tables.size());
+            for (auto e : tables) {
+                out.PutLong(e->terrain);
+                out.PutByte(e->x);
+                out.PutByte(e->y);
+                out.PutBytes(e->dis, sizeof(e->dis));
+            }
+        }
+
+        void LoadOpponentStatistics(BlobReader &in) {
+            OpponentModel model;
+            model.observedTurn = in.GetInt();
+            for (int tank = 0; tank < tankPerSide; ++tank) {
+                model.predicted[tank] = in.GetInt();
+                model.followed[tank] = in.GetInt();
+                for (int &count : model.histogram[tank])count = in.GetInt();
+            }
+            if (in.ok)opponentModel = model;
+        }
+
+        void SaveOpponentStatistics(BlobWriter &out) {
+            out.PutInt(opponentModel.observedTurn);
+            for (int tank = 0; tank < tankPerSide; ++tank) {
+                out.PutInt(opponentModel.predicted[tank]);
+                out.PutInt(opponentModel.followed[tank]);
+                for (int count : opponentModel.histogram[tank])out.PutInt(count);
+            }
+        }
+
+        // 残局表大部分是 0，连续的 0 存为 (0, 个数)
+        void LoadEndgameTable(BlobReader &in) {
+            unsigned long long terrain = in.GetLong();
+            int i = 0;
+            while (i < Endgame::stateCount && in.ok) {
+                int v = in.GetByte();
+                if (v == 0) {
+                    int run = in.GetByte();
+                    if (run == 0 || i + run > Endgame::stateCount)in.ok = false;
+                    for (; run > 0 && in.ok; --run)Endgame::value[i++] = 0;
+                } else
+                    Endgame::value[i++] = (signed char) v;
+            }
+            Endgame::terrain = terrain;
+            Endgame::ready = in.ok;
+        }
+
+        void SaveEndgameTable(BlobWriter &out) {
+            out.PutLong(Endgame::terrain);
+            for (int i = 0; i < Endgame::stateCount;) {
+                if (Endgame::value[i]) {
+                    out.PutByte((unsigned char) Endgame::value[i++]);
+                    continue;
+                }
+                int run = 0;
+                while (i < Endgame::stateCount && !Endgame::value[i] && run < 255)++i, ++run;
+                out.PutByte(0);
+                out.PutByte(run);
+            }
+        }
+
+        // 在重放历史之前调用；签名或版本不符时忽略整个 data
+        void Load(const string &data) {
+            string bytes;
+            if (data.empty() || !Base64Decode(data, bytes))return;
+            BlobReader in(bytes);
+            if (in.GetByte() != version)return;
+            for (int v : signature)
+                if (in.GetInt() != v)return;
+            while (in.ok && !in.AtEnd()) {
+                size_t sectionEnd;
+                int tag = in.BeginSection(sectionEnd);
+                if (!in.ok)break;
+                switch (tag) {
+                    case DistanceTables:
+                        LoadDistanceTables(in);
+                        break;
+                    case OpponentStatistics:
+                        LoadOpponentStatistics(in);
+                        break;
+                    case EndgameTable:
+                        LoadEndgameTable(in);
+                        break;
+                    default:;
+                }
+                in.ok = true;
+                in.EndSection(sectionEnd);
+            }
+        }
+
+        string Save() {
+            BlobWriter out;
+            out.PutByte(version);
+            for (int v : signature)out.PutInt(v);
+            out.BeginSection(DistanceTables);
+            SaveDistanceTables(out);
+            out.EndSection();
+            out.BeginSection(OpponentStatistics);
+            SaveOpponentStatistics(out);
+            out.EndSection();
+            // 砖块变了的残局表没有用，不再保存；太大的也不保存，下回合需要时再建
+            if (Endgame::Ready(*field)) {
+                BlobWriter table;
+                SaveEndgameTable(table);
+                if (table.Bytes().size() <= Endgame::maxBytes) {
+                    out.BeginSection(EndgameTable);
+                    out.PutBytes(table.Bytes().data(), table.Bytes().size());
+                    out.EndSection();
+                }
+            }
+            return Base64Encode(out.Bytes());
         }
-        Internals::_processRequestOrResponse(input, true);
+    }
+
+    // 从输入流（例如 cin 或者 fstream）读取回合信息，存入 TankField，并提取上回合存储的 data 和 globaldata
+    // 输入可以是单行也可以是多行，读到最外层的 JSON 值结束为止
+    void ReadInput(istream &in, string &outData, string &outGlobalData) {
+        Internals::ProtocolInput input;
+        {
+            PROFILE_SCOPE(ParseInput);
+            Internals::ProtocolReader(in).Parse(input);
+        }
+        if (!input.requests.empty() && input.requests[0].isField) {
+            Persistence::SetSignature(input.requests[0]);
+            Persistence::Load(input.data);
+        }
+        int n = input.requests.size();
+        for (int i = 0; i < n; i++) {
+            Internals::_processRequest(input.requests[i]);
+            if (i < n - 1 && i < (int) input.responses.size())
+                Internals::_processRequestOrResponse(input.responses[i].act, false);
+        }
+        outData = input.data;
+        outGlobalData = input.globaldata;
     }
 
     // 提交决策并退出，下回合时会重新运行程序
-    void SubmitAndExit(Action tank0, Action tank1, string debug = "", string data = "", string globaldata = "") {
+    void SubmitAndExit(Action tank0, Action tank1, const string &debug = "", const string &data = "",
+                       const string &globaldata = "") {
         Internals::_submitAction(tank0, tank1, debug, data, globaldata);
-#ifndef _BOTZONE_ONLINE
-        std::cerr << cnt << endl;
-#endif
         exit(0);
     }
 
     // 提交决策，下回合时程序继续运行（需要在 Botzone 上提交 Bot 时选择“允许长时运行”）
     // 如果游戏结束，程序会被系统杀死
     void SubmitAndDontExit(Action tank0, Action tank1) {
-        Internals::_submitAction(tank0, tank1);
+        Internals::_submitAction(tank0, tank1, "", "", "", true);
         field->nextAction[field->mySide][0] = tank0;
         field->nextAction[field->mySide][1] = tank1;
-        cout << ">>>BOTZONE_REQUEST_KEEP_RUNNING<<<" << endl;
     }
 
+    // 一次搜索独占的可变数据：局面副本、工作区和统计
+    // 搜索之间只共享只读的对手模型和加锁的 DistanceCache，各用一个上下文就可以在不同线程里同时搜索
+    struct SearchContext {
+        struct Stats {
+            long long nodes = 0;
+            long long quiescenceNodes = 0;
+            string debug;
+        };
+
+        TankField board;
+        Workspace work;
+        Stats stats;
+
+        explicit SearchContext(const TankField &root) : board(root) {}
+    };
+
     struct DecisionTree {
+        SearchContext &ctx;
+        TankField &board;
         const int side, tank;
-        clock_t endTime;
+        std::chrono::steady_clock::time_point endTime;
         static const int maxDepth = 4;
 
+        // 静态搜索：到达 maxDepth 时如果还有对射的威胁，只用射击和躲避继续搜，最多再深 maxQuiescenceDepth 层
+        // 每个叶子最多展开 quiescenceBudget 个节点，用完按 EstimateAttack 估值
+        // 自己不在对方射线上时可以不接战，静态估值就是这一方的下界（stand pat）：够截断就直接返回，否则作为 beta 的初值
+        static const int maxQuiescenceDepth = 4;
+        static const int quiescenceBudget = 48;
+        int quiescenceLeft = 0;
+
+        // 到了 endTime 就不再展开，剩下的节点都按叶子估值；每 256 个节点看一次表
+        bool timeUp = false;
+
         double CountDown() {
-            return (endTime - clock()) * 1.0 / CLOCKS_PER_SEC;
+            return std::chrono::duration<double>(endTime - std::chrono::steady_clock::now()).count();
+        }
+
+        bool OutOfTime() {
+            if (!timeUp && (ctx.stats.nodes & 255) == 0)
+                timeUp = CountDown() <= 0;
+            return timeUp;
         }
 
         static constexpr Action acts[2][9] = {
@@ -1210,123 +3098,170 @@ namespace TankGame {
         }
 
         int EstimateCross(Action act0, Action act1) {
-            Action pattern = field->GetPattern(!side, tank);
-            for (auto act2:acts[!side]) {
+            Action pattern = board.GetPattern(!side, tank);
+            if (!opponentModel.TrustPattern(tank))pattern = Invalid;
+            for (auto act2:MoveList(acts[!side], board.LegalActions(!side, tank))) {
                 if (pattern != Invalid && pattern != act2)continue;
-                if (field->ActionIsValid(!side, tank, act2)) {
-                    field->nextAction[side][tank] = act0;
-                    field->nextAction[!side][!tank] = act1;
-                    field->nextAction[!side][tank] = act2;
-                    field->nextAction[side][!tank] = Stay;
-                    field->DoAction();
-                    int ret = (int) 1e8;
-                    if (field->CrossShoot(!side, !tank))ret = 1;
-                    if (field->CrossShoot(!side, tank))ret = 1;
-                    if (field->CrossShoot(side, tank))ret = (int) -1e9;
-                    if (!field->tankAlive[side][tank])ret = (int) -1e9;
-                    if (!field->tankAlive[!side][tank])ret = 1;
-                    field->Revert();
-                    if (ret < 0)return ret;
-//                    if (field->WillKill(!side, tank, act2, side, tank, act0))return (int) -1e8;
-//                    if (field->WillKill(side, tank, act0, !side, tank, act2))return (int) 0;
-                }
+                board.nextAction[side][tank] = act0;
+                board.nextAction[!side][!tank] = act1;
+                board.nextAction[!side][tank] = act2;
+                board.nextAction[side][!tank] = Stay;
+                board.DoAction();
+                int ret = (int) 1e8;
+                if (board.CrossShoot(!side, !tank))ret = 1;
+                if (board.CrossShoot(!side, tank))ret = 1;
+                if (board.CrossShoot(side, tank))ret = (int) -1e9;
+                if (!board.tankAlive[side][tank])ret = (int) -1e9;
+                if (!board.tankAlive[!side][tank])ret = 1;
+                board.Revert();
+                if (ret < 0)return ret;
+//                if (board.WillKill(!side, tank, act2, side, tank, act0))return (int) -1e8;
+//                if (board.WillKill(side, tank, act0, !side, tank, act2))return (int) 0;
             }
             return 0;
         }
 
         int table[9][9];
 
+        // 两个对位的坦克中有一个能打到另一个
+        bool Tactical() {
+            return board.ThreatNow(side, tank).Test(board.tankX[!side][!tank], board.tankY[!side][!tank]) ||
+                   board.ThreatNow(!side, !tank).Test(board.tankX[side][tank], board.tankY[side][tank]);
+        }
+
+        // 静态搜索中 (s, t) 可以用的动作：射击、走出对手射线的移动，本身不在射线上时可以原地不动
+        // 一个都没有时（刚射击过又无处可躲）保留全部合法动作
+        unsigned TacticalActions(int s, int t) {
+            unsigned legal = board.LegalActions(s, t);
+            const Bitboard &threat = board.ThreatNow(!s, !t);
+            int x = board.tankX[s][t], y = board.tankY[s][t];
+            unsigned tactical = legal & (ActionBit(UpShoot) | ActionBit(RightShoot) | ActionBit(DownShoot) |
+                                         ActionBit(LeftShoot));
+            if (!threat.Test(x, y))
+                tactical |= ActionBit(Stay);
+            for (int dir = Up; dir <= Left; dir++)
+                if ((legal & ActionBit((Action) dir)) && !threat.Test(x + dx[dir], y + dy[dir]))
+                    tactical |= ActionBit((Action) dir);
+            return tactical ? tactical : legal;
+        }
+
+        // 叶子估值：加载了网络权重时用网络，否则用手写的 EstimateAttack；对方配对坦克已死时仍按 EstimateAttack 判
+        int Evaluate() {
+#ifdef ALPHATANK_NETWORK
+            if (Network::ready && board.tankAlive[!side][!tank])
+                return Network::Evaluate(board, side, tank);
+#endif
+            return board.EstimateAttack(ctx.work, side, tank);
+        }
+
         pair<pair<int, Action>, Action> MinMax(int depth = 0, int alpha = (int) 1e9) {
-            ++cnt;
-            GameResult result = field->GetGameResult(side, tank);
+            ++ctx.stats.nodes;
+            GameResult result = board.GetGameResult(side, tank);
             if (result == side)return make_pair(make_pair((int) 1e9, Invalid), Invalid);
             if (result == !side)return make_pair(make_pair((int) -1e9, Invalid), Invalid);
             if (result == Draw)return make_pair(make_pair(0, Invalid), Invalid);
-            if (!field->tankAlive[side][tank])return make_pair(make_pair((int) -1e8, Stay), Stay);
-            if (field->CrossShoot(side, tank))return make_pair(make_pair((int) -1e8, Stay), Stay);
-            if (depth >= maxDepth) return make_pair(make_pair(field->EstimateAttack(side, tank), Invalid), Invalid);
+            if (!board.tankAlive[side][tank])return make_pair(make_pair((int) -1e8, Stay), Stay);
+            if (depth > 0 && board.tankAlive[!side][!tank] && Endgame::IsDuel(board)) {
+                // 一对一且地形与残局表相同：查表，在第 drawTurn 回合判平局之前能分出胜负才算数
+                int verdict = Endgame::Lookup(board, side);
+                if (verdict && board.currentTurn + std::abs(verdict) <= drawTurn + 1)
+                    return make_pair(make_pair(verdict > 0 ? (int) 1e9 - verdict : (int) -1e9 - verdict, Invalid),
+                                     Invalid);
+            }
+            if (board.CrossShoot(side, tank))return make_pair(make_pair((int) -1e8, Stay), Stay);
+            if (depth > 0 && OutOfTime())
+                return make_pair(make_pair(Evaluate(), Invalid), Invalid);
+            bool quiescence = depth >= maxDepth;
             int beta = (int) -150000, secbeta = (int) -150000;
+            if (quiescence) {
+                if (depth == maxDepth)quiescenceLeft = quiescenceBudget;
+                if (depth >= maxDepth + maxQuiescenceDepth || quiescenceLeft <= 0 || !Tactical())
+                    return make_pair(make_pair(Evaluate(), Invalid), Invalid);
+                if (!board.ThreatNow(!side, !tank).Test(board.tankX[side][tank], board.tankY[side][tank])) {
+                    int standPat = Evaluate();
+                    if (standPat >= alpha)
+                        return make_pair(make_pair(standPat, Invalid), Invalid);
+                    beta = max(beta, standPat);
+                }
+                --quiescenceLeft;
+                ++ctx.stats.quiescenceNodes;
+            }
             Action act = Invalid, secact = Invalid;
-            Action pattern = field->GetPattern(!side, !tank);
+            Action pattern = board.GetPattern(!side, !tank);
+            if (!opponentModel.TrustPattern(!tank))pattern = Invalid;
+            MoveList moves(acts[side], quiescence ? TacticalActions(side, tank) : board.LegalActions(side, tank));
+            MoveList replies(acts[!side], quiescence ? TacticalActions(!side, !tank) : board.LegalActions(!side, !tank));
             if (depth <= 3) {// quick judge
-                for (auto act0:acts[side]) {
-                    if (field->ActionIsValid(side, tank, act0)) {
-                        field->nextAction[side][tank] = act0;
-                        int x = field->getDirection(!side, !tank);
-                        field->nextAction[!side][!tank] = Stay;
-                        if (depth == 0 && pattern != Invalid)field->nextAction[!side][!tank] = pattern;
-                        field->nextAction[side][!tank] = Stay;
-                        field->nextAction[!side][tank] = Stay;
-                        field->DoAction();
-                        GameResult result = field->GetGameResult(side, tank);
-                        int tmp = beta;
-                        if (result == side)tmp = (int) 1e9;
-                        else if (result == !side);
-                        else if (result == Draw);
-                        field->Revert();
-                        tmp = LessStepIsBetter(tmp);
-                        if (depth == 0)tmp += EstimateCross(act0, Stay);
-                        if (tmp > beta) {
-                            secbeta = beta;
-                            beta = tmp;
-                            secact = act;
-                            act = act0;
-                        } else if (tmp > secbeta) {
-                            secbeta = tmp;
-                            secact = act0;
-                        }
+                for (auto act0:moves) {
+                    board.nextAction[side][tank] = act0;
+                    int x = board.getDirection(!side, !tank);
+                    board.nextAction[!side][!tank] = Stay;
+                    if (depth == 0 && pattern != Invalid)board.nextAction[!side][!tank] = pattern;
+                    board.nextAction[side][!tank] = Stay;
+                    board.nextAction[!side][tank] = Stay;
+                    board.DoAction();
+                    GameResult result = board.GetGameResult(side, tank);
+                    int tmp = beta;
+                    if (result == side)tmp = (int) 1e9;
+                    else if (result == !side);
+                    else if (result == Draw);
+                    board.Revert();
+                    tmp = LessStepIsBetter(tmp);
+                    if (depth == 0)tmp += EstimateCross(act0, Stay);
+                    if (tmp > beta) {
+                        secbeta = beta;
+                        beta = tmp;
+                        secact = act;
+                        act = act0;
+                    } else if (tmp > secbeta) {
+                        secbeta = tmp;
+                        secact = act0;
                     }
                 }
             }
-            for (auto act0:acts[side]) {
+            for (auto act0:moves) {
                 if (beta >= alpha)break;
-                if (field->ActionIsValid(side, tank, act0)) {
-                    int gamma = (int) 1e9;
-                    if (depth <= 3) {// quick judge
-                        for (auto act1:acts[!side]) {
-                            if (depth == 0 && pattern != Invalid && pattern != act1)continue;
-                            if (field->ActionIsValid(!side, !tank, act1)) {
-                                field->nextAction[side][tank] = act0;
-                                field->nextAction[!side][!tank] = act1;
-                                field->nextAction[side][!tank] = Stay;
-                                field->nextAction[!side][tank] = Stay;
-                                field->DoAction();
-                                GameResult result = field->GetGameResult(side, tank);
-                                if (result == side);
-                                else if (result == !side)gamma = min(gamma, (int) -1e9);
-                                else if (result == Draw)gamma = min(gamma, 0);
-                                else if (!field->tankAlive[side][tank])gamma = min(gamma, (int) -1e8);
-                                else if (field->CrossShoot(side, tank))gamma = min(gamma, (int) -1e8);
-                                field->Revert();
-                            }
-                        }
-                    }
-                    for (auto act1:acts[!side]) {
-                        if (gamma <= beta)break;
+                int gamma = (int) 1e9;
+                if (depth <= 3) {// quick judge
+                    for (auto act1:replies) {
                         if (depth == 0 && pattern != Invalid && pattern != act1)continue;
-                        if (field->ActionIsValid(!side, !tank, act1)) {
-                            field->nextAction[side][tank] = act0;
-                            field->nextAction[!side][!tank] = act1;
-                            field->nextAction[side][!tank] = Stay;
-                            field->nextAction[!side][tank] = Stay;
-                            field->DoAction();
-                            int tmp = MinMax(depth + 1, gamma).first.first;
-                            field->Revert();
-                            if (depth == 0)tmp += EstimateCross(act0, act1);
-//                            if (depth == 0)table[act0 + 1][act1 + 1] = tmp;
-                            gamma = min(gamma, tmp);
-                        }
-                    }
-                    if (gamma > beta) {
-                        secbeta = beta;
-                        beta = gamma;
-                        secact = act;
-                        act = act0;
-                    } else if (gamma > secbeta) {
-                        secbeta = gamma;
-                        secact = act0;
+                        board.nextAction[side][tank] = act0;
+                        board.nextAction[!side][!tank] = act1;
+                        board.nextAction[side][!tank] = Stay;
+                        board.nextAction[!side][tank] = Stay;
+                        board.DoAction();
+                        GameResult result = board.GetGameResult(side, tank);
+                        if (result == side);
+                        else if (result == !side)gamma = min(gamma, (int) -1e9);
+                        else if (result == Draw)gamma = min(gamma, 0);
+                        else if (!board.tankAlive[side][tank])gamma = min(gamma, (int) -1e8);
+                        else if (board.CrossShoot(side, tank))gamma = min(gamma, (int) -1e8);
+                        board.Revert();
                     }
                 }
+                for (auto act1:replies) {
+                    if (gamma <= beta)break;
+                    if (depth == 0 && pattern != Invalid && pattern != act1)continue;
+                    board.nextAction[side][tank] = act0;
+                    board.nextAction[!side][!tank] = act1;
+                    board.nextAction[side][!tank] = Stay;
+                    board.nextAction[!side][tank] = Stay;
+                    board.DoAction();
+                    int tmp = MinMax(depth + 1, gamma).first.first;
+                    board.Revert();
+                    if (depth == 0)tmp += EstimateCross(act0, act1);
+//                    if (depth == 0)table[act0 + 1][act1 + 1] = tmp;
+                    gamma = min(gamma, tmp);
+                }
+                if (gamma > beta) {
+                    secbeta = beta;
+                    beta = gamma;
+                    secact = act;
+                    act = act0;
+                } else if (gamma > secbeta) {
+                    secbeta = gamma;
+                    secact = act0;
+                }
             }
             return make_pair(make_pair(LessStepIsBetter(beta), act), secact);
         }
@@ -1335,49 +3270,45 @@ namespace TankGame {
             Action act = Invalid;
             int mn = (int) 1e9;
             int count[9]{0};
-//            if (field->CanTankShootEachOther(side, tank, !side, tank) &&
-//                field->CanTankShootEachOther(side, tank, !side, !tank))
+            MoveList moves(acts[side], board.LegalActions(side, tank));
+            MoveList replies(acts[!side], board.LegalActions(!side, !tank));
+//            if (board.CanTankShootEachOther(side, tank, !side, tank) &&
+//                board.CanTankShootEachOther(side, tank, !side, !tank))
 //                return Stay;
-            for (auto act0:acts[side]) {
-                if (field->ActionIsValid(side, tank, act0)) {
-                    bool flag = true;
-                    for (auto act1:acts[!side]) {
-//                        if (!flag)break;
-                        if (field->ActionIsValid(!side, !tank, act1)) {
-                            field->nextAction[side][tank] = act0;
-                            field->nextAction[!side][!tank] = act1;
-                            field->nextAction[side][!tank] = Stay;
-                            field->nextAction[!side][tank] = Stay;
-                            field->DoAction();
-                            bool tmp = field->Defensible(side, tank);
-                            field->Revert();
-                            tmp &= EstimateCross(act0, Stay) >= 0;
-                            if (tmp)++count[act0 + 1];
-                            table[act0 + 1][act1 + 1] = tmp;
-                            if (!tmp)flag = false;
-                        }
-                    }
-                    field->nextAction[side][tank] = act0;
-                    field->nextAction[!side][!tank] = Stay;
-                    field->nextAction[side][!tank] = Stay;
-                    field->nextAction[!side][tank] = Stay;
-                    field->DoAction();
-                    field->InitDistance(side, tank);
-                    if (flag && field->dis[side][tank][baseY[side]][baseX[side]] < mn) {
-                        act = act0;
-                        mn = field->dis[side][tank][baseY[side]][baseX[side]];
-                    }
-                    field->Revert();
+            for (auto act0:moves) {
+                bool flag = true;
+                for (auto act1:replies) {
+//                    if (!flag)break;
+                    board.nextAction[side][tank] = act0;
+                    board.nextAction[!side][!tank] = act1;
+                    board.nextAction[side][!tank] = Stay;
+                    board.nextAction[!side][tank] = Stay;
+                    board.DoAction();
+                    bool tmp = board.Defensible(ctx.work, side, tank);
+                    board.Revert();
+                    tmp &= EstimateCross(act0, Stay) >= 0;
+                    if (tmp)++count[act0 + 1];
+                    table[act0 + 1][act1 + 1] = tmp;
+                    if (!tmp)flag = false;
+                }
+                board.nextAction[side][tank] = act0;
+                board.nextAction[!side][!tank] = Stay;
+                board.nextAction[side][!tank] = Stay;
+                board.nextAction[!side][tank] = Stay;
+                board.DoAction();
+                board.InitDistance(ctx.work, side, tank);
+                if (flag && ctx.work.cache.dis[side][tank][baseY[side]][baseX[side]] < mn) {
+                    act = act0;
+                    mn = ctx.work.cache.dis[side][tank][baseY[side]][baseX[side]];
                 }
+                board.Revert();
             }
             if (act == Invalid) {
                 int mx = -1;
-                for (auto act0:acts[side]) {
-                    if (field->ActionIsValid(side, tank, act0)) {
-                        if (count[act0 + 1] > mx) {
-                            mx = count[act0 + 1];
-                            act = act0;
-                        }
+                for (auto act0:moves) {
+                    if (count[act0 + 1] > mx) {
+                        mx = count[act0 + 1];
+                        act = act0;
                     }
                 }
             }
@@ -1386,33 +3317,30 @@ namespace TankGame {
 
         void DebugTable() {
 #ifndef _BOTZONE_ONLINE
+            MoveList moves(acts[side], board.LegalActions(side, tank));
+            MoveList replies(acts[!side], board.LegalActions(!side, !tank));
             printf("%12c", ' ');
-            for (auto act1:acts[!side]) {
-                if (field->ActionIsValid(!side, !tank, act1)) {
-                    printf("%12s", ActionToString(act1));
-                }
+            for (auto act1:replies) {
+                printf("%12s", ActionToString(act1));
             }
             puts("");
-            for (auto act0:acts[side]) {
-                if (field->ActionIsValid(side, tank, act0)) {
-                    printf("%12s", ActionToString(act0));
-                    for (auto act1:acts[!side]) {
-                        if (field->ActionIsValid(!side, !tank, act1)) {
-                            printf("%12d", table[act0 + 1][act1 + 1]);
-                        }
-                    }
-                    puts("");
+            for (auto act0:moves) {
+                printf("%12s", ActionToString(act0));
+                for (auto act1:replies) {
+                    printf("%12d", table[act0 + 1][act1 + 1]);
                 }
+                puts("");
             }
             puts("===============================================================================================================");
 #endif
         }
 
         pair<Action, Action> GetAction() {
+            PROFILE_SCOPE(Search);
             auto[pa, secact] = MinMax();
             auto[value, act] = pa;
-            debug += ' ' + std::to_string(value) + ' ';
-//            if (value <= -100000 && (act == Invalid || field->Defensible(side, tank))) {
+            ctx.stats.debug += ' ' + std::to_string(value) + ' ';
+//            if (value <= -100000 && (act == Invalid || board.Defensible(ctx.work, side, tank))) {
 //                Action defense = Defense();
 //                DebugTable();
 //                return Defense();
@@ -1422,24 +3350,264 @@ namespace TankGame {
             return make_pair(act, secact);
         }
 
-        DecisionTree(int tank, clock_t endTime) : endTime(endTime), side(TankGame::field->mySide), tank(tank) {}
+        DecisionTree(SearchContext &ctx, int tank, std::chrono::steady_clock::time_point endTime)
+                : ctx(ctx), board(ctx.board), side(ctx.board.mySide), tank(tank), endTime(endTime) {}
     };
 
+    // 证明数搜索（df-pn）：attacker 能否在 depth 回合内强制取胜（打掉对方基地或全歼对方坦克）
+    // 双方同时行动，这里让攻方先选联合动作、守方看到之后再应对，证出来的必胜对守方任何应对都成立
+    // 攻方节点（OR）是局面，守方节点（AND）是局面加攻方的联合动作；两种节点都存进自己的置换表，键里带上当前回合和剩余回合数
+    struct ProofSearch {
+        static constexpr unsigned infinity = 1u << 30;
+        static const int maxJoint = 81;
+
+        struct Entry {
+            unsigned long long key = 0;
+            unsigned pn = 1, dn = 1;
+        };
+
+        TankField board;
+        const int attacker;
+        vector<Entry> table;
+        long long nodes = 0, budget;
+        std::chrono::steady_clock::time_point endTime;
+        Action move[tankPerSide] = {Invalid, Invalid};
+
+        // 根节点的联合动作和它们是否已证明；置换表总是替换，根的必胜动作不能靠事后查表
+        int rootDepth = 0, rootCount = 0, rootJoints[maxJoint];
+        bool rootProven[maxJoint];
+
+        static unsigned Add(unsigned a, unsigned b) {
+            return std::min(a + b, infinity);
+        }
+
+        static unsigned long long Mix(unsigned long long x) {
+            return Zobrist::SplitMix(x);
+        }
+
+        bool OutOfBudget() {
+            return nodes >= budget || ((nodes & 1023) == 0 && std::chrono::steady_clock::now() >= endTime);
+        }
+
+        unsigned long long OrKey(int depth) {
+            // Hash() 不含回合数；同一局面晚一回合离平局更近，证明不能混用
+            return Mix(board.Hash() + ((unsigned long long) board.currentTurn << 8 | depth) * 0x9E3779B97F4A7C15ull + attacker);
+        }
+
+        static unsigned long long AndKey(unsigned long long orKey, int joint) {
+            return Mix(orKey ^ ((joint + 1ull) << 40));
+        }
+
+        void Lookup(unsigned long long key, unsigned &pn, unsigned &dn) const {
+            const Entry &e = table[key & (table.size() - 1)];
+            if (e.key == key)
+                pn = e.pn, dn = e.dn;
+            else
+                pn = dn = 1;
+        }
+
+        void Store(unsigned long long key, unsigned pn, unsigned dn) {
+            Entry &e = table[key & (table.size() - 1)];
+            e.key = key, e.pn = pn, e.dn = dn;
+        }
+
+        // 一方两个坦克的联合动作，编号为 (act0 + 1) * 9 + act1 + 1
+        int JointActions(int side, int out[maxJoint]) {
+            int n = 0;
+            for (auto act0:MoveList(DecisionTree::acts[side], board.LegalActions(side, 0)))
+                for (auto act1:MoveList(DecisionTree::acts[side], board.LegalActions(side, 1)))
+                    out[n++] = (act0 + 1) * 9 + act1 + 1;
+            return n;
+        }
+
+        void Apply(int attack, int defend) {
+            board.nextAction[attacker][0] = (Action) (attack / 9 - 1);
+            board.nextAction[attacker][1] = (Action) (attack % 9 - 1);
+            board.nextAction[!attacker][0] = (Action) (defend / 9 - 1);
+            board.nextAction[!attacker][1] = (Action) (defend % 9 - 1);
+            board.DoAction();
+            nodes++;
+        }
+
+        // 攻方节点：pn 取子节点最小值，dn 取和
+        void SolveOr(int depth, unsigned thpn, unsigned thdn, unsigned &pn, unsigned &dn) {
+            GameResult result = board.GetGameResult();
+            if (result == attacker) {
+                pn = 0, dn = infinity;
+                return;
+            }
+            if (result != NotFinished || depth == 0) {
+                pn = infinity, dn = 0;
+                return;
+            }
+            unsigned long long key = OrKey(depth);
+            int joints[maxJoint], n = JointActions(attacker, joints);
+            if (depth == rootDepth) {
+                rootCount = n;
+                std::copy(joints, joints + n, rootJoints);
+            }
+            while (true) {
+                int best = 0;
+                unsigned pn2 = infinity, bestdn = 1;
+                pn = infinity, dn = 0;
+                for (int i = 0; i < n; i++) {
+                    unsigned cpn, cdn;
+                    Lookup(AndKey(key, joints[i]), cpn, cdn);
+                    if (depth == rootDepth)
+                        rootProven[i] = !cpn;
+                    dn = Add(dn, cdn);
+                    if (cpn < pn)
+                        pn2 = pn, pn = cpn, best = i, bestdn = cdn;
+                    else if (cpn < pn2)
+                        pn2 = cpn;
+                }
+                if (pn >= thpn || dn >= thdn || OutOfBudget())
+                    break;
+                unsigned cpn, cdn;
+                SolveAnd(key, depth, joints[best], std::min(thpn, Add(pn2, 1)), Add(thdn - dn, bestdn), cpn, cdn);
+            }
+            Store(key, pn, dn);
+        }
+
+        // 守方节点：pn 取和，dn 取最小值；子局面的键和胜负先一次算好
+        void SolveAnd(unsigned long long orKey, int depth, int attack, unsigned thpn, unsigned thdn,
+                      unsigned &pn, unsigned &dn) {
+            unsigned long long key = AndKey(orKey, attack);
+            int joints[maxJoint], n = JointActions(!attacker, joints);
+            unsigned long long childKey[maxJoint];
+            signed char solved[maxJoint]; // 1 已证明，-1 已否定，0 未知
+            for (int i = 0; i < n; i++) {
+                Apply(attack, joints[i]);
+                GameResult result = board.GetGameResult();
+                solved[i] = result == attacker ? 1 : result != NotFinished || depth == 1 ? -1 : 0;
+                if (!solved[i])
+                    childKey[i] = OrKey(depth - 1);
+                board.Revert();
+            }
+            while (true) {
+                int best = 0;
+                unsigned dn2 = infinity, bestpn = 1;
+                pn = 0, dn = infinity;
+                for (int i = 0; i < n; i++) {
+                    unsigned cpn = 0, cdn = infinity;
+                    if (solved[i] < 0)
+                        cpn = infinity, cdn = 0;
+                    else if (!solved[i])
+                        Lookup(childKey[i], cpn, cdn);
+                    pn = Add(pn, cpn);
+                    if (cdn < dn)
+                        dn2 = dn, dn = cdn, best = i, bestpn = cpn;
+                    else if (cdn < dn2)
+                        dn2 = cdn;
+                }
+                if (pn >= thpn || dn >= thdn || OutOfBudget())
+                    break;
+                unsigned cpn, cdn;
+                Apply(attack, joints[best]);
+                SolveOr(depth - 1, Add(thpn - pn, bestpn), std::min(thdn, Add(dn2, 1)), cpn, cdn);
+                board.Revert();
+            }
+            Store(key, pn, dn);
+        }
+
+        // 己方两个坦克互不误伤、不挤进同一格（SubmitAction 里 MayKill/MayStack 的检查）
+        bool SelfSafe(Action act0, Action act1) {
+            return !board.MayKill(attacker, 0, act0, attacker, 1, act1) &&
+                   !board.MayKill(attacker, 1, act1, attacker, 0, act0) &&
+                   !board.MayStack(attacker, 0, act0, attacker, 1, act1);
+        }
+
+        // 逐步加深回合数，证出来就记下根节点的必胜动作，优先选不会误伤自己的
+        bool Solve(int maxDepth) {
+            for (int depth = 1; depth <= maxDepth && !OutOfBudget(); depth++) {
+                unsigned pn, dn;
+                rootDepth = depth;
+                SolveOr(depth, infinity, infinity, pn, dn);
+                if (pn)
+                    continue;
+                bool found = false;
+                for (int i = 0; i < rootCount; i++)
+                    if (rootProven[i]) {
+                        Action act0 = (Action) (rootJoints[i] / 9 - 1), act1 = (Action) (rootJoints[i] % 9 - 1);
+                        bool safe = SelfSafe(act0, act1);
+                        if (!found || safe)
+                            move[0] = act0, move[1] = act1, found = true;
+                        if (safe)
+                            break;
+                    }
+                if (found)
+                    return true;
+            }
+            return false;
+        }
+
+        ProofSearch(const TankField &root, int attacker, long long budget, std::chrono::steady_clock::time_point endTime,
+                    int tableBits = 18)
+                : board(root), attacker(attacker), table(size_t(1) << tableBits), budget(budget), endTime(endTime) {}
+    };
+
+    // 证明数搜索的回合数上限和节点（DoAction 次数）预算
+    const int proofDepth = 4;
+    const long long proofBudget = 300000;
+
     void SubmitAction() {
-        int TIME = (field->currentTurn == 1 ? 2 : 1) * CLOCKS_PER_SEC;
-        auto tree0 = new DecisionTree(0, startTime + (int) (0.49 * TIME));
-        auto tree1 = new DecisionTree(1, startTime + (int) (0.99 * TIME));
-        auto[act0, secact0] = tree0->GetAction();
-        auto[act1, secact1] = tree1->GetAction();
+        std::chrono::milliseconds TIME(field->currentTurn == 1 ? 2000 : 1000);
+#ifdef ALPHATANK_NETWORK
+        Network::Init();
+        if (Network::ready)
+            field->RefreshAccumulator();
+#endif
+        // 第一回合时间加倍，顺便建好残局表；之后只在一对一且砖块变了时重建
+        // 建表最多占这回合四分之一的时间，剩下的留给搜索
+        if (field->currentTurn == 1 || (Endgame::IsDuel(*field) && !Endgame::Ready(*field)))
+            Endgame::Build(*field, startTime + TIME / 4);
+        // MinMax 和证明数搜索共用一个截止时间，留一成给输出和进程退出
+        auto deadline = startTime + TIME * 9 / 10;
+        SearchContext context0(*field), context1(*field);
+        DecisionTree tree0(context0, 0, deadline);
+        DecisionTree tree1(context1, 1, deadline);
+        // 证明数搜索看我方能否强制取胜，证出来就照着走，不用再信 MinMax 的估值
+        ProofSearch prover(*field, field->mySide, proofBudget, deadline);
+        bool proved = false;
+        pair<Action, Action> result0(Stay, Stay), result1(Stay, Stay);
+#ifdef ALPHATANK_THREADS
+        // 两个坦克的搜索互不依赖，和证明数搜索一起并行进行
+        std::thread worker([&]() { result0 = tree0.GetAction(); });
+        std::thread proofWorker([&]() { proved = prover.Solve(proofDepth); });
+        result1 = tree1.GetAction();
+        worker.join();
+        proofWorker.join();
+#else
+        // 单线程时先做定深的 MinMax，证明数搜索只用剩下的时间
+        result0 = tree0.GetAction();
+        result1 = tree1.GetAction();
+        proved = prover.Solve(proofDepth);
+#endif
+        auto[act0, secact0] = result0;
+        auto[act1, secact1] = result1;
+        // 证出来的动作先换上，再过误伤和重叠的检查；Solve 已经优先挑了不误伤的
+        if (proved) {
+            act0 = prover.move[0];
+            act1 = prover.move[1];
+        }
         if (field->MayKill(field->mySide, 0, act0, field->mySide, 1, act1))act0 = secact0;
         if (field->MayKill(field->mySide, 1, act1, field->mySide, 0, act0))act1 = secact1;
         if (field->MayStack(field->mySide, 0, act0, field->mySide, 1, act1))act0 = secact0;
         if (field->MayStack(field->mySide, 1, act1, field->mySide, 0, act0))act1 = secact1;
-        debug += std::to_string((clock() - startTime) * 1.0 / CLOCKS_PER_SEC);
-        SubmitAndExit(act0, act1, debug);
+        string debug = context0.stats.debug + context1.stats.debug;
+        if (proved)
+            debug += " proved ";
+        debug += std::to_string(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+#ifndef _BOTZONE_ONLINE
+        std::cerr << context0.stats.nodes + context1.stats.nodes << " nodes, "
+                  << context0.stats.quiescenceNodes + context1.stats.quiescenceNodes << " in quiescence, "
+                  << prover.nodes << " proof nodes" << (proved ? " (proved)" : "") << endl;
+#endif
+        SubmitAndExit(act0, act1, debug, Persistence::Save());
     }
 }
 
+#ifndef ALPHATANK_NO_MAIN
 
 int RandBetween(int from, int to) {
     return rand() % (to - from) + from;
@@ -1458,7 +3626,8 @@ int main() {
 
     string data, globaldata;
     TankGame::ReadInput(cin, data, globaldata);
-    startTime = clock();
+    startTime = std::chrono::steady_clock::now();
     TankGame::field->DebugPrint();
     TankGame::SubmitAction();
-}
\ No newline at end of file
+}
+#endif
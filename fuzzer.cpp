@@ -0,0 +1,320 @@
+// 模拟器差分测试
+// 用种子生成地图和随机对局，同时在参考实现（裁判的 TankField）和被测实现上执行，
+// 每回合比较合法动作和完整局面，对局结束后逐回合 Revert 再比较；
+// 发现不一致时把动作序列缩到最短并打印出来
+//
+// fuzzer [games] [threads] [firstSeed]
+//
+// 要测别的实现（位棋盘、copy-make 等），仿照 BotEngine 写一个适配器，换掉 Fuzz<BotEngine> 即可
+#define TANKJUDGE_NO_MAIN
+#define TankGame RefGame
+#define TankJudge RefJudge
+#include "judge.cpp"
+#undef TankGame
+#undef TankJudge
+#define ALPHATANK_NO_MAIN
+#include "alphatank.cpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+namespace Fuzzer {
+    using RefJudge::MapRandom;
+    using std::vector;
+    const int sideCount = 2, tankPerSide = 2, tankCount = sideCount * tankPerSide;
+    using TankGame::fieldWidth;
+    using TankGame::fieldHeight;
+    using TankGame::mapWords;
+    const int cellCount = fieldWidth * fieldHeight;
+
+    // 裁判只有 9x9 一种场地，被测实现要按同样的尺寸编译
+    static_assert(fieldWidth == RefGame::fieldWidth && fieldHeight == RefGame::fieldHeight, "裁判和被测实现的场地尺寸不同");
+    static_assert(tankPerSide == TankGame::tankPerSide && tankPerSide == RefGame::tankPerSide, "每方坦克数不同");
+
+    // 与实现无关的局面，用来比较
+    struct State {
+        unsigned char cell[cellCount];
+        bool tankAlive[sideCount][tankPerSide];
+        bool baseAlive[sideCount];
+        int tankX[sideCount][tankPerSide], tankY[sideCount][tankPerSide];
+        int turn;
+        int lastAction[sideCount][tankPerSide];
+        int result;
+        unsigned short legal[sideCount][tankPerSide]; // 存活坦克的合法动作，第 act + 1 位
+
+        // 返回所有不同之处的描述，相同时返回空串
+        string Diff(const State &b) const {
+            std::ostringstream out;
+            for (int c = 0; c < cellCount; c++)
+                if (cell[c] != b.cell[c])
+                    out << "cell (" << c % fieldWidth << "," << c / fieldWidth << "): " << (int) cell[c] << " vs " << (int) b.cell[c] << "; ";
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++) {
+                    if (tankAlive[side][tank] != b.tankAlive[side][tank] || tankX[side][tank] != b.tankX[side][tank] ||
+                        tankY[side][tank] != b.tankY[side][tank])
+                        out << "tank " << side << tank << ": " << tankAlive[side][tank] << "@(" << tankX[side][tank]
+                            << "," << tankY[side][tank] << ") vs " << b.tankAlive[side][tank] << "@("
+                            << b.tankX[side][tank] << "," << b.tankY[side][tank] << "); ";
+                    if (lastAction[side][tank] != b.lastAction[side][tank])
+                        out << "last action " << side << tank << ": " << lastAction[side][tank] << " vs "
+                            << b.lastAction[side][tank] << "; ";
+                    if (legal[side][tank] != b.legal[side][tank])
+                        out << "legal " << side << tank << ": " << legal[side][tank] << " vs " << b.legal[side][tank] << "; ";
+                }
+            for (int side = 0; side < sideCount; side++)
+                if (baseAlive[side] != b.baseAlive[side])
+                    out << "base " << side << ": " << baseAlive[side] << " vs " << b.baseAlive[side] << "; ";
+            if (turn != b.turn)
+                out << "turn " << turn << " vs " << b.turn << "; ";
+            // 裁判在 maxTurn 之后判平局，Bot 的判定放宽到 105 回合，这一处不算不一致
+            bool turnLimit = turn > RefGame::maxTurn && result == RefGame::Draw && b.result == TankGame::NotFinished;
+            if (result != b.result && !turnLimit)
+                out << "result " << result << " vs " << b.result << "; ";
+            return out.str();
+        }
+    };
+
+    template<typename Field>
+    void Capture(Field &f, State &s) {
+        for (int y = 0; y < fieldHeight; y++)
+            for (int x = 0; x < fieldWidth; x++)
+                s.cell[y * fieldWidth + x] = f.gameField[y][x];
+        for (int side = 0; side < sideCount; side++) {
+            s.baseAlive[side] = f.baseAlive[side];
+            for (int tank = 0; tank < tankPerSide; tank++) {
+                s.tankAlive[side][tank] = f.tankAlive[side][tank];
+                s.tankX[side][tank] = f.tankX[side][tank];
+                s.tankY[side][tank] = f.tankY[side][tank];
+                s.lastAction[side][tank] = f.previousActions[f.currentTurn - 1][side][tank];
+                s.legal[side][tank] = 0;
+                if (f.tankAlive[side][tank])
+                    for (int act = -1; act < 8; act++)
+                        if (f.ActionIsValid(side, tank, (std::remove_reference_t<decltype(f.nextAction[0][0])>) act))
+                            s.legal[side][tank] |= 1 << (act + 1);
+            }
+        }
+        s.turn = f.currentTurn;
+        s.result = f.GetGameResult();
+    }
+
+    // 适配器：Reset / Apply（执行四个坦克的动作）/ Undo / Capture
+    template<typename Field>
+    struct FieldEngine {
+        std::unique_ptr<Field> field;
+
+        void Reset(int brick[mapWords], int water[mapWords], int steel[mapWords]) {
+            field.reset(new Field(brick, water, steel, 0));
+        }
+
+        bool Apply(const int joint[tankCount]) {
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    field->nextAction[side][tank] = (std::remove_reference_t<decltype(field->nextAction[0][0])>) joint[side * tankPerSide + tank];
+            return field->DoAction();
+        }
+
+        bool Undo() {
+            return field->Revert();
+        }
+
+        void Snapshot(State &s) {
+            Capture(*field, s);
+        }
+    };
+
+    typedef FieldEngine<RefGame::TankField> ReferenceEngine;
+    typedef FieldEngine<TankGame::TankField> BotEngine;
+
+    struct Map {
+        int brick[mapWords], water[mapWords], steel[mapWords];
+    };
+
+    Map MapForSeed(unsigned seed) {
+        Map m;
+        MapRandom rng(seed);
+        RefJudge::GenerateMap(rng, m.brick, m.water, m.steel);
+        return m;
+    }
+
+    typedef vector<std::array<int, tankCount>> Sequence;
+
+    // 按参考实现执行动作序列，不合法的动作换成 Stay；返回第一处不一致的描述
+    // 执行过的（修正后的）序列写回 seq
+    template<typename Engine>
+    string Replay(const Map &map, Sequence &seq) {
+        Map m = map;
+        ReferenceEngine ref;
+        Engine opt;
+        ref.Reset(m.brick, m.water, m.steel);
+        opt.Reset(m.brick, m.water, m.steel);
+        State a, b;
+        vector<State> history;
+        ref.Snapshot(a);
+        opt.Snapshot(b);
+        string diff = a.Diff(b);
+        if (!diff.empty())
+            return "initial: " + diff;
+        history.push_back(a);
+        size_t played = 0;
+        for (; played < seq.size() && a.result == RefGame::NotFinished; played++) {
+            auto &joint = seq[played];
+            for (int i = 0; i < tankCount; i++)
+                if (!(a.legal[i / tankPerSide][i % tankPerSide] >> (joint[i] + 1) & 1))
+                    joint[i] = -1;
+            bool refOk = ref.Apply(joint.data()), optOk = opt.Apply(joint.data());
+            if (refOk != optOk)
+                return "turn " + std::to_string(played + 1) + ": DoAction returned " + std::to_string(refOk) +
+                       " vs " + std::to_string(optOk);
+            ref.Snapshot(a);
+            opt.Snapshot(b);
+            diff = a.Diff(b);
+            if (!diff.empty()) {
+                seq.resize(played + 1);
+                return "after turn " + std::to_string(played + 1) + ": " + diff;
+            }
+            history.push_back(a);
+        }
+        seq.resize(played);
+        for (size_t t = played; t > 0; t--) {
+            ref.Undo();
+            opt.Undo();
+            ref.Snapshot(a);
+            opt.Snapshot(b);
+            diff = history[t - 1].Diff(a);
+            if (!diff.empty())
+                return "reference revert to turn " + std::to_string(t) + ": " + diff;
+            diff = a.Diff(b);
+            if (!diff.empty())
+                return "revert to turn " + std::to_string(t) + ": " + diff;
+        }
+        return "";
+    }
+
+    // 随机对局：每个存活坦克在参考实现的合法动作里均匀选
+    Sequence RandomGame(const Map &map, unsigned seed) {
+        Map m = map;
+        ReferenceEngine ref;
+        ref.Reset(m.brick, m.water, m.steel);
+        MapRandom rng(seed ^ 0x5DEECE66Du);
+        Sequence seq;
+        State s;
+        for (ref.Snapshot(s); s.result == RefGame::NotFinished; ref.Snapshot(s)) {
+            std::array<int, tankCount> joint;
+            for (int i = 0; i < tankCount; i++) {
+                unsigned legal = s.legal[i / tankPerSide][i % tankPerSide];
+                joint[i] = -1;
+                if (legal) {
+                    unsigned k = rng.Below(__builtin_popcount(legal));
+                    while (k--)
+                        legal &= legal - 1;
+                    joint[i] = __builtin_ctz(legal) - 1;
+                }
+            }
+            ref.Apply(joint.data());
+            seq.push_back(joint);
+        }
+        return seq;
+    }
+
+    // 缩小失败的序列：先删掉成段的回合（ddmin），再把单个动作换成 Stay，直到不再变化
+    template<typename Engine>
+    Sequence Minimize(const Map &map, Sequence seq) {
+        auto fails = [&](Sequence &candidate) {
+            return !Replay<Engine>(map, candidate).empty();
+        };
+        fails(seq);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t chunk = std::max<size_t>(seq.size() / 2, 1); chunk > 0; chunk /= 2)
+                for (size_t begin = 0; begin < seq.size();) {
+                    Sequence candidate(seq.begin(), seq.begin() + begin);
+                    candidate.insert(candidate.end(), seq.begin() + std::min(begin + chunk, seq.size()), seq.end());
+                    if (fails(candidate)) {
+                        seq = candidate;
+                        changed = true;
+                    } else
+                        begin += chunk;
+                }
+            for (size_t t = 0; t < seq.size(); t++)
+                for (int i = 0; i < tankCount; i++) {
+                    if (seq[t][i] == -1)
+                        continue;
+                    Sequence candidate = seq;
+                    candidate[t][i] = -1;
+                    if (fails(candidate)) {
+                        seq = candidate;
+                        changed = true;
+                    }
+                }
+        }
+        return seq;
+    }
+
+    struct Failure {
+        unsigned seed;
+        Map map;
+        Sequence seq;
+        string what;
+    };
+
+    template<typename Engine>
+    int Fuzz(unsigned long long games, int threads, unsigned firstSeed) {
+        std::atomic<unsigned long long> next(0), turns(0), done(0);
+        std::atomic<bool> failed(false);
+        std::mutex lock;
+        Failure failure;
+        auto begin = std::chrono::steady_clock::now();
+        vector<std::thread> workers;
+        for (int t = 0; t < threads; t++)
+            workers.emplace_back([&]() {
+                for (unsigned long long i; !failed && (i = next++) < games;) {
+                    unsigned seed = firstSeed + (unsigned) i;
+                    Map map = MapForSeed(seed);
+                    Sequence seq = RandomGame(map, seed);
+                    turns += seq.size();
+                    string what = Replay<Engine>(map, seq);
+                    if (!what.empty()) {
+                        std::lock_guard<std::mutex> guard(lock);
+                        if (!failed.exchange(true))
+                            failure = {seed, map, seq, what};
+                        return;
+                    }
+                    done++;
+                }
+            });
+        for (auto &w : workers)
+            w.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        cout << done << " games, " << turns << " turns, " << threads << " threads, " << seconds << " s ("
+             << (long long) (done / seconds) << " games/s, " << (long long) (turns / seconds) << " turns/s)" << endl;
+        if (!failed)
+            return 0;
+
+        Sequence minimal = Minimize<Engine>(failure.map, failure.seq);
+        string what = Replay<Engine>(failure.map, minimal);
+        const Map &m = failure.map;
+        cout << "MISMATCH in game seed " << failure.seed << ": " << failure.what << endl
+             << "minimized to " << minimal.size() << " turns: " << what << endl
+             << "brickfield [" << m.brick[0] << "," << m.brick[1] << "," << m.brick[2] << "] waterfield ["
+             << m.water[0] << "," << m.water[1] << "," << m.water[2] << "] steelfield [" << m.steel[0] << ","
+             << m.steel[1] << "," << m.steel[2] << "]" << endl;
+        for (size_t t = 0; t < minimal.size(); t++)
+            cout << "turn " << t + 1 << ": blue [" << minimal[t][0] << "," << minimal[t][1] << "] red ["
+                 << minimal[t][2] << "," << minimal[t][3] << "]" << endl;
+        return 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long long games = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned firstSeed = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1;
+    return Fuzzer::Fuzz<Fuzzer::BotEngine>(games, threads, firstSeed);
+}
@@ -11,11 +11,11 @@
 #include <ctime>
 #include <cstring>
 #include <queue>
-#ifdef _BOTZONE_ONLINE
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <chrono>
 #include "jsoncpp/json.h"
-#else
-#include <json/json.h>
-#endif
 
 using std::string;
 using std::cin;
@@ -675,7 +675,7 @@ namespace TankGame
             Json::Value requests = input["requests"], responses = input["responses"];
             if (!requests.isNull() && requests.isArray())
             {
-                size_t i, n = requests.size();
+                int i, n = requests.size();
                 for (i = 0; i < n; i++)
                 {
                     Internals::_processRequestOrResponse(requests[i], true);
@@ -722,8 +722,6 @@ namespace TankJudge
 
     int fieldBinary[3],waterBinary[3],steelBinary[3];
 
-    bool visited[fieldHeight][fieldWidth];
-
     /*****************copied from TankField****************/
     int tankX[sideCount][tankPerSide] = {
         { fieldWidth / 2 - 2, fieldWidth / 2 + 2 },{ fieldWidth / 2 + 2, fieldWidth / 2 - 2 }
@@ -757,120 +755,272 @@ namespace TankJudge
         { Left, Down, Up, Right },
         { Left, Down, Right, Up }
     };
-    //BFS to ensure that there is only one connected component
-    //InitializeField already ensures that water&steel will not appear on base and tank
-    struct node{int x,y;node(){}node(int xx,int yy){x=xx,y=yy;}};
-    std::queue<node> q;
-    bool EnsureConnected(bool hasWater[fieldHeight][fieldWidth],bool hasSteel[fieldHeight][fieldWidth]){
-        int jishu = 0, jishu2 = 0;
-        bool vis[fieldHeight][fieldWidth] = {0};
-        for(int i = 0;i < fieldHeight; i++)
-            for(int j = 0;j < fieldWidth; j++)
-                if(!(hasWater[i][j]||hasSteel[i][j]))
-                    jishu++;
-        q.push(node(baseX[0],baseY[0]));
-        vis[baseX[0]][baseY[0]] = 1;
-        jishu2 = 1;
-        while(!q.empty()){
-            int x = q.front().x,y = q.front().y;
-            q.pop();
-            for(int i = 0;i < 4; i++){
-                int eks = x + dx[i];
-                int wai = y + dy[i];
-                if(CoordValid(eks,wai) && !vis[eks][wai] && (!(hasWater[eks][wai]||hasSteel[eks][wai])) ){
-                    q.push(node(eks,wai));
-                    vis[eks][wai] = 1;
-                    jishu2++;
+    // 地图生成用的快速随机数（xorshift64*），与 rand() 无关，各线程可以各自持有
+    struct MapRandom
+    {
+        unsigned long long state;
+
+        explicit MapRandom(unsigned long long seed = 1) : state(seed * 0x9E3779B97F4A7C15ull + 0x2545F4914F6CDD1Dull)
+        {
+            if (!state)
+                state = 1;
+        }
+
+        unsigned Next()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return (unsigned)((state * 2685821657736338717ull) >> 32);
+        }
+
+        // [0, n) 内均匀
+        unsigned Below(unsigned n)
+        {
+            return (unsigned)(((unsigned long long)Next() * n) >> 32);
+        }
+    };
+
+    // initdata 没有给出地图时，由 seed 初始化
+    MapRandom mapRandom;
+
+    enum MapCell
+    {
+        OpenCell = 0,
+        BrickCell = 1,
+        WaterCell = 2,
+        SteelCell = 3
+    };
+
+    const int cellCount = fieldHeight * fieldWidth;
+
+    inline int Mirror(int cell)
+    {
+        return cellCount - 1 - cell;
+    }
+
+    // 水和钢不连通，砖和空地连通
+    inline bool Passable(unsigned char type)
+    {
+        return type == OpenCell || type == BrickCell;
+    }
+
+    // 从己方基地出发 BFS，返回能到达的格子数，reached 记录是否到达
+    int MarkReachable(const unsigned char cells[cellCount], bool reached[cellCount])
+    {
+        int queue[cellCount], head = 0, tail = 0;
+        memset(reached, 0, cellCount);
+        int start = baseY[0] * fieldWidth + baseX[0];
+        reached[start] = true;
+        queue[tail++] = start;
+        while (head < tail)
+        {
+            int c = queue[head++], x = c % fieldWidth, y = c / fieldWidth;
+            for (int i = 0; i < 4; i++)
+            {
+                int nx = x + dx[i], ny = y + dy[i], n = ny * fieldWidth + nx;
+                if (CoordValid(nx, ny) && !reached[n] && Passable(cells[n]))
+                {
+                    reached[n] = true;
+                    queue[tail++] = n;
                 }
             }
         }
-        return jishu2==jishu;
+        return tail;
     }
-    //initialize the battlefield before 1st round
-    //insert water here
-    void InitializeField()
+
+    // 局部修复：从已连通的区域出发，穿过可以改动的水/钢，找到最近的未连通空地，
+    // 把路径上的水/钢（连同中心对称的格子）改成砖。找不到路径时返回 false
+    bool RepairConnectivity(unsigned char cells[cellCount], const bool fixed[cellCount])
     {
-        memset(visited, 0, sizeof(visited));
-        bool hasBrick[fieldHeight][fieldWidth] = {};
-        bool hasWater[fieldHeight][fieldWidth] = {};
-        bool hasSteel[fieldHeight][fieldWidth] = {};
-        int portionH = (fieldHeight + 1) / 2;
-        do{//optimistic approach: assume that disconnectivity will not appear normally
-            for (int y = 0; y < portionH; y++)
-                for (int x = 0; x < fieldWidth; x++){
-                    hasBrick[y][x] = rand() % 3 > 1;// 1/3 brick
-                    if(hasBrick[y][x]==false)hasWater[y][x] = rand() % 27 > 22; // (3/4)*(4/27)= 1/9 water
-                    if(hasBrick[y][x]==false&&hasWater[y][x]==false)hasSteel[y][x]=rand() % 23 > 18;//(3/4)*(23/27)*(4/23)=1/9 steel
+        bool reached[cellCount];
+        int passable = 0;
+        for (int c = 0; c < cellCount; c++)
+            passable += Passable(cells[c]);
+        while (MarkReachable(cells, reached) < passable)
+        {
+            int queue[cellCount], from[cellCount], head = 0, tail = 0, target = -1;
+            for (int c = 0; c < cellCount; c++)
+            {
+                from[c] = -2;
+                if (reached[c])
+                {
+                    from[c] = -1;
+                    queue[tail++] = c;
                 }
-            int bx = baseX[0], by = baseY[0];
-            hasBrick[by + 1][bx + 1] = hasBrick[by + 1][bx - 1] =
-                hasBrick[by][bx + 1] = hasBrick[by][bx - 1] = true;
-            hasWater[by + 1][bx + 1] = hasWater[by + 1][bx - 1] =
-                hasWater[by][bx + 1] = hasWater[by][bx - 1] = false;
-            hasSteel[by + 1][bx + 1] = hasSteel[by + 1][bx - 1] =
-                hasSteel[by][bx + 1] = hasSteel[by][bx - 1] = false;
-            hasBrick[by + 1][bx] = true;
-            hasBrick[by][bx] = hasBrick[by][bx + 2] = hasBrick[by][bx - 2] = false;
-            hasWater[by][bx] = hasWater[by + 1][bx] = hasWater[by][bx + 2] = hasWater[by][bx - 2] = false;
-            hasSteel[by][bx] = hasSteel[by + 1][bx] = hasSteel[by][bx + 2] = hasSteel[by][bx - 2] = false;
-            //symmetry
-            for (int y = 0; y < portionH; y++)
-                for (int x = 0; x < fieldWidth; x++){
-                    hasBrick[fieldHeight - y - 1][fieldWidth - x - 1] = hasBrick[y][x];
-                    hasWater[fieldHeight - y - 1][fieldWidth - x - 1] = hasWater[y][x];
-                    hasSteel[fieldHeight - y - 1][fieldWidth - x - 1] = hasSteel[y][x];
+            }
+            while (head < tail && target < 0)
+            {
+                int c = queue[head++], x = c % fieldWidth, y = c / fieldWidth;
+                for (int i = 0; i < 4 && target < 0; i++)
+                {
+                    int nx = x + dx[i], ny = y + dy[i], n = ny * fieldWidth + nx;
+                    if (!CoordValid(nx, ny) || from[n] != -2)
+                        continue;
+                    if (Passable(cells[n]))
+                    {
+                        from[n] = c;
+                        target = n;
+                    }
+                    else if (!fixed[n] && !fixed[Mirror(n)])
+                    {
+                        from[n] = c;
+                        queue[tail++] = n;
+                    }
                 }
-            //separate the field into 4 pieces, each with a tank
-            for (int y = 2; y < fieldHeight - 2; y++){
-                hasBrick[y][fieldWidth / 2] = true;
-                hasWater[y][fieldWidth / 2] = false;
-                hasSteel[y][fieldWidth / 2] = false;
             }
-            for (int x = 0; x < fieldWidth; x++){
-                hasBrick[fieldHeight / 2][x] = true;
-                hasWater[fieldHeight / 2][x] = false;
-                hasSteel[fieldHeight / 2][x] = false;
+            if (target < 0)
+                return false;
+            for (int c = from[target]; c >= 0 && !reached[c]; c = from[c])
+            {
+                passable += (cells[c] != BrickCell) + (Mirror(c) != c && cells[Mirror(c)] != BrickCell);
+                cells[c] = cells[Mirror(c)] = BrickCell;
+            }
+        }
+        return true;
+    }
+
+    // 构造一张满足约束的地图：中心对称、基地周围固定、中线砖墙和钢块、可通行区域只有一个连通块
+    // 先按原来的概率随机上半场，再强制固定格子，最后对连通性做局部修复（而不是整张重新随机）
+    void GenerateMap(MapRandom& rng, int brick[3], int water[3], int steel[3])
+    {
+        unsigned char cells[cellCount];
+        bool fixed[cellCount] = {};
+        while (true)
+        {
+            int portionH = (fieldHeight + 1) / 2;
+            for (int c = 0; c < portionH * fieldWidth; c++)
+            {
+                if (rng.Below(3) > 1)// 1/3 brick
+                    cells[c] = BrickCell;
+                else if (rng.Below(27) > 22)// (3/4)*(4/27)= 1/9 water
+                    cells[c] = WaterCell;
+                else if (rng.Below(23) > 18)//(3/4)*(23/27)*(4/23)=1/9 steel
+                    cells[c] = SteelCell;
+                else
+                    cells[c] = OpenCell;
             }
+            auto set = [&](int x, int y, MapCell type)
+            {
+                cells[y * fieldWidth + x] = type;
+                fixed[y * fieldWidth + x] = true;
+            };
+            int bx = baseX[0], by = baseY[0];
+            set(bx + 1, by + 1, BrickCell);
+            set(bx - 1, by + 1, BrickCell);
+            set(bx + 1, by, BrickCell);
+            set(bx - 1, by, BrickCell);
+            set(bx, by + 1, BrickCell);
+            set(bx, by, OpenCell);
+            set(bx + 2, by, OpenCell);
+            set(bx - 2, by, OpenCell);
+            //symmetry
+            for (int c = 0; c < portionH * fieldWidth; c++)
+            {
+                cells[Mirror(c)] = cells[c];
+                fixed[Mirror(c)] = fixed[c];
+            }
+            //separate the field into 4 pieces, each with a tank
+            for (int y = 2; y < fieldHeight - 2; y++)
+                set(fieldWidth / 2, y, BrickCell);
+            for (int x = 0; x < fieldWidth; x++)
+                set(x, fieldHeight / 2, BrickCell);
             for (int side = 0; side < sideCount; side++)
             {
                 for (int tank = 0; tank < tankPerSide; tank++)
-                    hasSteel[tankY[side][tank]][tankX[side][tank]] = hasWater[tankY[side][tank]][tankX[side][tank]] = false;
-                hasSteel[baseY[side]][baseX[side]] = hasWater[baseY[side]][baseX[side]] = hasBrick[baseY[side]][baseX[side]] = false;
+                {
+                    int c = tankY[side][tank] * fieldWidth + tankX[side][tank];
+                    if (!Passable(cells[c]))
+                        cells[c] = OpenCell;
+                    fixed[c] = true;
+                }
+                set(baseX[side], baseY[side], OpenCell);
             }
             //add steel onto midpoint&midtankpoint
-            hasBrick[fieldHeight/2][fieldWidth/2]=false;
-            hasWater[fieldHeight/2][fieldWidth/2]=false;
-            hasSteel[fieldHeight/2][fieldWidth/2]=true;
+            set(fieldWidth / 2, fieldHeight / 2, SteelCell);
+            for (int tank = 0; tank < tankPerSide; tank++)
+                set(tankX[0][tank], fieldHeight / 2, SteelCell);
 
-            for (int tank = 0; tank < tankPerSide; tank++){
-            hasSteel[fieldHeight/2][tankX[0][tank]]=true;
-            hasWater[fieldHeight/2][tankX[0][tank]]=hasBrick[fieldHeight/2][tankX[0][tank]]=false;
-            }
+            if (RepairConnectivity(cells, fixed))
+                break;
         }
-        while(!EnsureConnected(hasWater,hasSteel));
         for (int i = 0; i < 3; i++)//3 row as one number
         {
+            brick[i] = water[i] = steel[i] = 0;
             int mask = 1;
-            for (int y = i * 3; y < (i + 1) * 3; y++)
+            for (int c = i * 3 * fieldWidth; c < (i + 1) * 3 * fieldWidth; c++)
             {
-                for (int x = 0; x < fieldWidth; x++)
-                {
-                    if (hasBrick[y][x])
-                        fieldBinary[i] |= mask;
-                    else if(hasWater[y][x])
-                        waterBinary[i] |= mask;
-                    else if(hasSteel[y][x])
-                        steelBinary[i] |= mask;
-                    mask <<= 1;
-                }
+                if (cells[c] == BrickCell)
+                    brick[i] |= mask;
+                else if (cells[c] == WaterCell)
+                    water[i] |= mask;
+                else if (cells[c] == SteelCell)
+                    steel[i] |= mask;
+                mask <<= 1;
             }
         }
     }
+
+    //initialize the battlefield before 1st round
+    void InitializeField()
+    {
+        GenerateMap(mapRandom, fieldBinary, waterBinary, steelBinary);
+    }
+
+    // 检查地图是否满足生成约束（用于测速时核对）
+    bool MapIsValid(const int brick[3], const int water[3], const int steel[3])
+    {
+        unsigned char cells[cellCount];
+        for (int c = 0; c < cellCount; c++)
+        {
+            int word = c / 27, mask = 1 << (c % 27);
+            cells[c] = brick[word] & mask ? BrickCell : water[word] & mask ? WaterCell :
+                steel[word] & mask ? SteelCell : OpenCell;
+        }
+        int passable = 0;
+        for (int c = 0; c < cellCount; c++)
+        {
+            if (cells[c] != cells[Mirror(c)])
+                return false;
+            passable += Passable(cells[c]);
+        }
+        for (int x = 0; x < fieldWidth; x++)
+            if (cells[fieldHeight / 2 * fieldWidth + x] !=
+                (x == fieldWidth / 2 || x == tankX[0][0] || x == tankX[0][1] ? SteelCell : BrickCell))
+                return false;
+        int b = baseY[0] * fieldWidth + baseX[0];
+        if (cells[b] != OpenCell || cells[b + 1] != BrickCell || cells[b - 1] != BrickCell ||
+            cells[b + fieldWidth] != BrickCell || cells[b + 2] != OpenCell || cells[b - 2] != OpenCell)
+            return false;
+        bool reached[cellCount];
+        return MarkReachable(cells, reached) == passable;
+    }
+
+    // judge map-bench [count] [seed]：生成 count 张地图并报告速度
+    int MapBench(int count, unsigned seed)
+    {
+        MapRandom rng(seed);
+        int brick[3], water[3], steel[3], invalid = 0;
+        long long bricks = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            GenerateMap(rng, brick, water, steel);
+            invalid += !MapIsValid(brick, water, steel);
+            for (int w = 0; w < 3; w++)
+                bricks += __builtin_popcount(brick[w]);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        cout << count << " maps in " << seconds << " s, " << (long long)(count / seconds) << " maps/s, "
+             << invalid << " invalid, " << (double)bricks / count << " bricks/map" << endl;
+        return invalid ? 1 : 0;
+    }
 }
 
 void validateImpl()
 {
     srand(time(0));
+    TankJudge::mapRandom = TankJudge::MapRandom(time(0));
     int i = 0;
     while (true)
     {
@@ -911,81 +1061,389 @@ void validateImpl()
     }
 }
 
-int main()
+// 二进制对局记录：地图（三组 27 位掩码）、种子、每回合每辆坦克一个字节的动作
+// 一个文件里可以顺序存放多局，加载后可以直接定位到任意一局的任意回合
+namespace TankReplay
 {
-    unsigned int seed;
-    const string int2str[] = { "0", "1" };
+    using namespace TankGame;
+    using std::vector;
 
-    Json::Reader reader;
-    Json::Value input, temp, output;
-    #ifdef _BOTZONE_ONLINE
-    reader.parse(cin, input);
-    #else
-    char *s="{\"log\":[{\"keep_running\":false,\"memory\":160,\"output\":{\"command\":\"request\",\"content\":{\"0\":{\"brickfield\":[71620266,4718352,44783889],\"waterfield\":[0,0,0],\"steelfield\":[0,0,0],\"mySide\":0},\"1\":{\"brickfield\":[71620266,4718352,44783889],\"waterfield\":[0,0,0],\"steelfield\":[0,0,0],\"mySide\":1}},\"display\":[71620266,4718352,44783889]},\"time\":3,\"verdict\":\"OK\"},{\"0\":{\"keep_running\":true,\"memory\":165,\"time\":89,\"verdict\":\"OK\",\"debug\":\"DEBUG!\",\"response\":[6,7]},\"1\":{\"keep_running\":true,\"memory\":20,\"time\":4,\"verdict\":\"OK\",\"response\":[0,4]}},{\"keep_running\":false,\"memory\":15,\"output\":{\"command\":\"request\",\"content\":{\"0\":[0,4],\"1\":[6,7]},\"display\":{\"0\":[6,7],\"1\":[0,4]}},\"time\":3,\"verdict\":\"OK\"},{\"0\":{\"keep_running\":true,\"memory\":165,\"time\":1,\"verdict\":\"OK\",\"debug\":\"DEBUG!\",\"response\":[2,-1]},\"1\":{\"keep_running\":true,\"memory\":20,\"time\":0,\"verdict\":\"OK\",\"response\":[0,0]}},{\"keep_running\":false,\"memory\":15,\"output\":{\"command\":\"request\",\"content\":{\"0\":[0,0],\"1\":[2,-1]},\"display\":{\"0\":[2,-1],\"1\":[0,0]}},\"time\":2,\"verdict\":\"OK\"},{\"0\":{\"keep_running\":true,\"memory\":165,\"time\":0,\"verdict\":\"OK\",\"debug\":\"DEBUG!\",\"response\":[0,7]},\"1\":{\"keep_running\":true,\"memory\":20,\"time\":0,\"verdict\":\"OK\",\"response\":[7,0]}}],\"initdata\":{\"brickfield\":[71620266,4718352,44783889],\"waterfield\":[0,0,0],\"steelfield\":[0,0,0],\"maxTurn\":100,\"seed\":1552650152}}";
-    reader.parse(s,input);
+    const char magic[4] = { 'A', 'T', 'R', '1' };
 
-    //test
-    {Json::FastWriter writer;
-     printf("%s\n\n",s);
-    cout << writer.write(input);}
-    #endif
-    Json::Value initdata = input["initdata"];
+    // magic(4) seed(4) maxTurn(2) turns(2) result(1) reserved(3) brick/water/steel(3*3*4)
+    const int headerSize = 52;
 
-    if (initdata.isString())
-        reader.parse(initdata.asString(), initdata);
-    if (initdata.isString())
-        initdata = Json::Value(Json::objectValue);
+    // 动作按 act + 2 存成一个字节，Invalid 为 0
+    const int bytesPerTurn = sideCount * tankPerSide;
 
-    temp = initdata["maxTurn"];
-    if (temp.isInt())
-        TankGame::maxTurn = temp.asUInt();
-    initdata["maxTurn"] = TankGame::maxTurn;
+    enum RecordResult
+    {
+        ResultBlue = 0,
+        ResultRed = 1,
+        ResultDraw = 2,
+        ResultUnfinished = 3
+    };
 
-    temp = initdata["seed"];
-    if (temp.isInt())
-        srand(seed = temp.asUInt());
-    else
-        srand(seed = time(nullptr));
-    initdata["seed"] = seed;
+    struct GameRecord
+    {
+        unsigned seed = 0;
+        int maxTurn = 100;
+        int result = ResultUnfinished;
+        int brickfield[3] = {}, waterfield[3] = {}, steelfield[3] = {};
+        // actions[(turn - 1) * bytesPerTurn + side * tankPerSide + tank]
+        vector<unsigned char> actions;
+
+        int Turns() const
+        {
+            return (int)actions.size() / bytesPerTurn;
+        }
+
+        Action GetAction(int turn, int side, int tank) const
+        {
+            return (Action)(actions[(turn - 1) * bytesPerTurn + side * tankPerSide + tank] - 2);
+        }
 
-    temp = initdata["brickfield"];
-    if (temp.isArray() && !temp.isNull()){
+        void AddTurn(Action act[sideCount][tankPerSide])
+        {
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    actions.push_back((unsigned char)(act[side][tank] + 2));
+        }
+    };
+
+    void PutInt(string& out, unsigned v, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            out += (char)((v >> (8 * i)) & 255);
+    }
+
+    unsigned GetInt(const unsigned char* p, int bytes)
+    {
+        unsigned v = 0;
+        for (int i = 0; i < bytes; i++)
+            v |= (unsigned)p[i] << (8 * i);
+        return v;
+    }
+
+    void Serialize(const GameRecord& record, string& out)
+    {
+        out.append(magic, 4);
+        PutInt(out, record.seed, 4);
+        PutInt(out, record.maxTurn, 2);
+        PutInt(out, record.Turns(), 2);
+        PutInt(out, record.result, 1);
+        PutInt(out, 0, 3);
         for (int i = 0; i < 3; i++)
-            TankJudge::fieldBinary[i] = temp[i].asInt();
-        initdata["brickfield"] = temp;
-        temp = initdata["waterfield"];
+            PutInt(out, record.brickfield[i], 4);
         for (int i = 0; i < 3; i++)
-            TankJudge::waterBinary[i] = temp[i].asInt();
-        initdata["waterfield"] = temp;
-        temp = initdata["steelfield"];
+            PutInt(out, record.waterfield[i], 4);
         for (int i = 0; i < 3; i++)
-            TankJudge::steelBinary[i] = temp[i].asInt();
-        initdata["steelfield"] = temp;
+            PutInt(out, record.steelfield[i], 4);
+        out.append((const char*)record.actions.data(), record.actions.size());
     }
-    else
+
+    // 一局记录在内存中的只读视图，动作直接指向文件数据
+    struct RecordView
     {
-        TankJudge::InitializeField();
-        temp = Json::Value(Json::arrayValue);
+        const unsigned char* header;
+
+        unsigned Seed() const { return GetInt(header + 4, 4); }
+        int MaxTurn() const { return GetInt(header + 8, 2); }
+        int Turns() const { return GetInt(header + 10, 2); }
+        int Result() const { return header[12]; }
+        int Field(int which, int i) const { return (int)GetInt(header + 16 + (which * 3 + i) * 4, 4); }
+        const unsigned char* Actions(int turn) const { return header + headerSize + (turn - 1) * bytesPerTurn; }
+        size_t Size() const { return headerSize + (size_t)Turns() * bytesPerTurn; }
+
+        GameRecord ToRecord() const
+        {
+            GameRecord record;
+            record.seed = Seed();
+            record.maxTurn = MaxTurn();
+            record.result = Result();
+            for (int i = 0; i < 3; i++)
+            {
+                record.brickfield[i] = Field(0, i);
+                record.waterfield[i] = Field(1, i);
+                record.steelfield[i] = Field(2, i);
+            }
+            record.actions.assign(Actions(1), Actions(1) + Turns() * bytesPerTurn);
+            return record;
+        }
+    };
+
+    // 整个文件读入内存并建立每局的偏移索引
+    class ReplayFile
+    {
+        string data;
+        vector<size_t> offsets;
+    public:
+        bool Load(std::istream& in)
+        {
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            offsets.clear();
+            size_t pos = 0;
+            while (pos + headerSize <= data.size())
+            {
+                if (memcmp(data.data() + pos, magic, 4) != 0)
+                    return false;
+                RecordView view = { (const unsigned char*)data.data() + pos };
+                if (pos + view.Size() > data.size())
+                    return false;
+                offsets.push_back(pos);
+                pos += view.Size();
+            }
+            return pos == data.size();
+        }
+
+        bool Load(const char* path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            return in && Load(in);
+        }
+
+        int Count() const { return (int)offsets.size(); }
+
+        RecordView Game(int index) const
+        {
+            return { (const unsigned char*)data.data() + offsets[index] };
+        }
+    };
+
+    // 把一局重放到第 turn 回合开始时（turn = 1 为初始局面），返回新建的 TankField
+    TankField* Seek(const RecordView& game, int turn)
+    {
+        int brick[3], water[3], steel[3];
         for (int i = 0; i < 3; i++)
-            temp[i] = TankJudge::fieldBinary[i];
-        initdata["brickfield"] = temp;
-        temp = Json::Value(Json::arrayValue);
+        {
+            brick[i] = game.Field(0, i);
+            water[i] = game.Field(1, i);
+            steel[i] = game.Field(2, i);
+        }
+        TankField* f = new TankField(brick, water, steel, 0);
+        for (int t = 1; t < turn && t <= game.Turns(); t++)
+        {
+            const unsigned char* act = game.Actions(t);
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    f->nextAction[side][tank] = (Action)(act[side * tankPerSide + tank] - 2);
+            if (!f->DoAction())
+                break;
+        }
+        return f;
+    }
+
+    // Botzone 裁判输入（{"log": [...], "initdata": {...}}）转成二进制记录
+    bool FromJson(Json::Value& input, GameRecord& record)
+    {
+        Json::Value initdata = input["initdata"];
+        Json::Reader reader;
+        if (initdata.isString())
+            reader.parse(initdata.asString(), initdata);
+        if (!initdata.isObject() || !initdata["brickfield"].isArray())
+            return false;
+        record.seed = initdata["seed"].asUInt();
+        if (initdata["maxTurn"].isInt())
+            record.maxTurn = initdata["maxTurn"].asInt();
         for (int i = 0; i < 3; i++)
-            temp[i] = TankJudge::waterBinary[i];
-        initdata["waterfield"] = temp;
-        temp = Json::Value(Json::arrayValue);
+        {
+            record.brickfield[i] = initdata["brickfield"][i].asInt();
+            record.waterfield[i] = initdata["waterfield"][i].asInt();
+            record.steelfield[i] = initdata["steelfield"][i].asInt();
+        }
+        record.actions.clear();
+        TankField game(record.brickfield, record.waterfield, record.steelfield, 0);
+        Json::Value log = input["log"];
+        int size = log.size();
+        for (int i = 1; i < size; i += 2)
+        {
+            Action act[sideCount][tankPerSide];
+            for (int side = 0; side < sideCount; side++)
+            {
+                Json::Value raw = log[i][side == 0 ? "0" : "1"],
+                    answer = raw["response"].isNull() ? raw["content"] : raw["response"];
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    act[side][tank] = answer.isArray() && answer[tank].isInt() ? (Action)answer[tank].asInt() : Invalid;
+            }
+            record.AddTurn(act);
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    game.nextAction[side][tank] = act[side][tank];
+            if (!game.DoAction())
+                break;
+        }
+        int result = game.GetGameResult();
+        record.result = result == NotFinished ? ResultUnfinished : result == Draw ? ResultDraw : result;
+        return true;
+    }
+
+    // 还原成裁判可以直接读入的 log（只包含裁判需要的字段）
+    Json::Value ToJson(const GameRecord& record)
+    {
+        const char* sideName[] = { "0", "1" };
+        Json::Value output(Json::objectValue), initdata(Json::objectValue), log(Json::arrayValue);
+        Json::Value brick(Json::arrayValue), water(Json::arrayValue), steel(Json::arrayValue);
         for (int i = 0; i < 3; i++)
-            temp[i] = TankJudge::steelBinary[i];
-        initdata["steelfield"] = temp;
+        {
+            brick[i] = record.brickfield[i];
+            water[i] = record.waterfield[i];
+            steel[i] = record.steelfield[i];
+        }
+        initdata["brickfield"] = brick;
+        initdata["waterfield"] = water;
+        initdata["steelfield"] = steel;
+        initdata["maxTurn"] = record.maxTurn;
+        initdata["seed"] = record.seed;
+
+        Json::Value request(Json::objectValue);
+        request["command"] = "request";
+        for (int side = 0; side < sideCount; side++)
+        {
+            Json::Value obj(Json::objectValue);
+            obj["brickfield"] = brick;
+            obj["waterfield"] = water;
+            obj["steelfield"] = steel;
+            obj["mySide"] = side;
+            request["content"][sideName[side]] = obj;
+        }
+        for (int turn = 1; turn <= record.Turns(); turn++)
+        {
+            Json::Value judgeEntry(Json::objectValue), botEntry(Json::objectValue);
+            judgeEntry["output"] = request;
+            log.append(judgeEntry);
+            request = Json::Value(Json::objectValue);
+            request["command"] = "request";
+            for (int side = 0; side < sideCount; side++)
+            {
+                Json::Value response(Json::arrayValue);
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    response[tank] = record.GetAction(turn, side, tank);
+                botEntry[sideName[side]]["response"] = response;
+                botEntry[sideName[side]]["verdict"] = "OK";
+                request["content"][sideName[1 - side]] = response;
+            }
+            log.append(botEntry);
+        }
+        output["log"] = log;
+        output["initdata"] = initdata;
+        return output;
     }
 
+    // judge replay-encode：stdin 的裁判输入 JSON -> stdout 的二进制记录（可以追加到同一个文件）
+    int Encode()
+    {
+        Json::Reader reader;
+        Json::Value input;
+        GameRecord record;
+        if (!reader.parse(cin, input) || !FromJson(input, record))
+        {
+            std::cerr << "replay-encode: cannot read judge log" << endl;
+            return 1;
+        }
+        string out;
+        Serialize(record, out);
+        cout.write(out.data(), out.size());
+        return 0;
+    }
+
+    // judge replay-decode [game]：stdin 的二进制记录 -> stdout 的裁判输入 JSON
+    int Decode(int index)
+    {
+        ReplayFile file;
+        if (!file.Load(cin) || index < 0 || index >= file.Count())
+        {
+            std::cerr << "replay-decode: bad replay file or game index" << endl;
+            return 1;
+        }
+        Json::FastWriter writer;
+        cout << writer.write(ToJson(file.Game(index).ToRecord()));
+        return 0;
+    }
 
-    TankGame::field = new TankGame::TankField(TankJudge::fieldBinary,TankJudge::waterBinary,TankJudge::steelBinary, 0);
+    // judge replay-show <file> <game> <turn>：打印某一局第 turn 回合开始时的局面
+    int Show(const char* path, int index, int turn)
+    {
+        ReplayFile file;
+        if (!file.Load(path) || index < 0 || index >= file.Count())
+        {
+            std::cerr << "replay-show: bad replay file or game index" << endl;
+            return 1;
+        }
+        TankField* f = Seek(file.Game(index), turn);
+        f->DebugPrint();
+        delete f;
+        return 0;
+    }
+}
 
-    input = input["log"];
+// 裁判的回合处理，供普通模式和增量模式共用
+namespace TankJudge
+{
+    const string int2str[] = { "0", "1" };
 
-    int size = input.size();
-    if (size == 0)//before 1st round
+    // 读取 initdata（没有地图就生成一张），并据此建立 TankGame::field
+    void SetupField(Json::Value& initdata)
+    {
+        Json::Reader reader;
+        Json::Value temp;
+        unsigned int seed;
+
+        if (initdata.isString())
+            reader.parse(initdata.asString(), initdata);
+        if (initdata.isString())
+            initdata = Json::Value(Json::objectValue);
+
+        temp = initdata["maxTurn"];
+        if (temp.isInt())
+            TankGame::maxTurn = temp.asUInt();
+        initdata["maxTurn"] = TankGame::maxTurn;
+
+        temp = initdata["seed"];
+        if (temp.isInt())
+            srand(seed = temp.asUInt());
+        else
+            srand(seed = time(nullptr));
+        mapRandom = MapRandom(seed);
+        initdata["seed"] = seed;
+
+        temp = initdata["brickfield"];
+        if (temp.isArray() && !temp.isNull()){
+            for (int i = 0; i < 3; i++)
+                fieldBinary[i] = temp[i].asInt();
+            initdata["brickfield"] = temp;
+            temp = initdata["waterfield"];
+            for (int i = 0; i < 3; i++)
+                waterBinary[i] = temp[i].asInt();
+            initdata["waterfield"] = temp;
+            temp = initdata["steelfield"];
+            for (int i = 0; i < 3; i++)
+                steelBinary[i] = temp[i].asInt();
+            initdata["steelfield"] = temp;
+        }
+        else
+        {
+            InitializeField();
+            temp = Json::Value(Json::arrayValue);
+            for (int i = 0; i < 3; i++)
+                temp[i] = fieldBinary[i];
+            initdata["brickfield"] = temp;
+            temp = Json::Value(Json::arrayValue);
+            for (int i = 0; i < 3; i++)
+                temp[i] = waterBinary[i];
+            initdata["waterfield"] = temp;
+            temp = Json::Value(Json::arrayValue);
+            for (int i = 0; i < 3; i++)
+                temp[i] = steelBinary[i];
+            initdata["steelfield"] = temp;
+        }
+
+        if (TankGame::field)
+            delete TankGame::field;
+        TankGame::field = new TankGame::TankField(fieldBinary, waterBinary, steelBinary, 0);
+    }
+
+    // 第一回合之前：把场地发给双方
+    void InitialRequest(Json::Value& initdata, Json::Value& output)
     {
         for (int side = 0; side < TankGame::sideCount; side++)
         {
@@ -1004,97 +1462,358 @@ int main()
         output["display"]["water"] = initdata["waterfield"];
         output["display"]["steel"] = initdata["steelfield"];
     }
-    else
+
+    //winning side {0,1}
+    void SetWinner(Json::Value& output, int to)
+    {
+        if (to == -1)
+            output["content"]["0"] = output["content"]["1"] = 1;
+        else if (to == 1)
+        {
+            output["content"]["0"] = 0;
+            output["content"]["1"] = 2;
+        }
+        else
+        {
+            output["content"]["0"] = 2;
+            output["content"]["1"] = 0;
+        }
+    }
+
+    // 执行一回合双方的回复（log 中的一项），isLast 时填写发给双方的 request
+    // 返回 false 表示对局已经结束
+    bool ProcessTurn(Json::Value response, bool isLast, Json::Value& output)
     {
         bool invalid[TankGame::sideCount] = {};
-        //winning side {0,1}
-        auto setWinner = [&] (int to) {
-            if (to == -1)
-                output["content"]["0"] = output["content"]["1"] = 1;
-            else if (to == 1)
+        for (int side = 0; side < TankGame::sideCount; side++)//simulate each round
+        {
+            Json::Value raw = response[int2str[side]],
+                answer = raw["response"].isNull() ? raw["content"] : raw["response"];
+            TankGame::Action act0, act1;
+            if (answer.isArray() && answer[0U].isInt() && answer[1U].isInt())
             {
-                output["content"]["0"] = 0;
-                output["content"]["1"] = 2;
+                act0 = (TankGame::Action)answer[0U].asInt();
+                act1 = (TankGame::Action)answer[1U].asInt();
+                if (isLast)
+                {
+                    auto action = Json::Value(Json::arrayValue);
+                    action[0U] = act0;
+                    action[1U] = act1;
+                    output["display"][int2str[side]] = output["content"][int2str[1 - side]] = action;
+                    if (!TankGame::field->tankAlive[side][0] || !TankGame::field->ActionIsValid(side, 0, act0))
+                        output["content"][int2str[1 - side]][0U] = -1;
+                    if (!TankGame::field->tankAlive[side][1] || !TankGame::field->ActionIsValid(side, 1, act1))
+                        output["content"][int2str[1 - side]][1U] = -1;
+                }
+                if ((!TankGame::field->tankAlive[side][0] || TankGame::field->ActionIsValid(side, 0, act0)) &&
+                    (!TankGame::field->tankAlive[side][1] || TankGame::field->ActionIsValid(side, 1, act1)))
+                {
+                    TankGame::field->nextAction[side][0] = act0;
+                    TankGame::field->nextAction[side][1] = act1;
+                    continue;
+                }
             }
+            invalid[side] = true;
+            output["display"]["loseReason"][side] = "INVALID_INPUT_VERDICT_" + raw["verdict"].asString();
+        }
+        if (invalid[0] || invalid[1])
+        {
+            output["command"] = "finish";
+            if (invalid[0] == invalid[1])
+                SetWinner(output, -1);
+            else if (invalid[0])
+                SetWinner(output, 1);
             else
+                SetWinner(output, 0);
+            return false;
+        }
+        else
+            TankGame::field->DoAction();
+
+        int result = TankGame::field->GetGameResult();
+        if (result != -2)
+        {
+            output["command"] = "finish";
+            SetWinner(output, result);
+            for (int side = 0; side < TankGame::sideCount; side++)
             {
-                output["content"]["0"] = 2;
-                output["content"]["1"] = 0;
+                bool tankExist = TankGame::field->tankAlive[side][0] || TankGame::field->tankAlive[side][1];
+                bool baseExist = TankGame::field->baseAlive[side];
+                if (!tankExist && !baseExist)
+                    output["display"]["loseReason"][side] = "BASE_TANK_ALL_DESTROYED";
+                else if (!tankExist)
+                    output["display"]["loseReason"][side] = "TANK_ALL_DESTROYED";
+                else if (!baseExist)
+                    output["display"]["loseReason"][side] = "BASE_DESTROYED";
             }
-        };
-        for (int i = 1; i < size; i += 2)
+            return false;
+        }
+        else if (isLast)
+            output["command"] = "request";
+        TankGame::field->DebugPrint();
+        return true;
+    }
+
+    // 从 log 的第 first 项（奇数项是双方回复）开始执行到最后
+    void ProcessLog(Json::Value& log, int first, Json::Value& output)
+    {
+        int size = log.size();
+        for (int i = first; i < size; i += 2)
+            if (!ProcessTurn(log[i], size - 1 == i, output))
+                break;
+    }
+}
+
+// 增量裁判：对局状态保存在内存（长时运行）或者旁路文件里，每次只执行最新一回合的回复，
+// 不再每回合从第一回合重放整个 log
+namespace TankIncremental
+{
+    using namespace TankGame;
+
+    // 最后一位是格式版本，布局改动时递增；版本不符的状态文件直接忽略，从头重放
+    const char magic[4] = { 'A', 'T', 'J', '2' };
+
+    // 已经执行过的回合数，以及 log 中对应的项数（1 + 2 * turns）
+    int appliedTurns = 0;
+
+    // 当前局面的快照，逐项按小端写出，不依赖结构体布局：
+    // magic(4) seed(4) brick/water/steel(3*3*4) appliedTurns(2) currentTurn(2)
+    // 每个格子的物件(fieldHeight*fieldWidth) 坦克存活(4) 基地存活(2) 坦克坐标 x+1、y+1(2*4)
+    // 然后是第 1 到 currentTurn - 1 回合所有坦克的动作，格式同 TankReplay（act + 2，每回合 4 字节）
+    // 回退用的 logs 不保存，恢复出的局面不能 Revert 到快照之前
+    const int headerSize = 48;
+    const int stateSize = fieldHeight * fieldWidth + sideCount * tankPerSide + sideCount + 2 * sideCount * tankPerSide;
+
+    void Capture(string& out, int seed)
+    {
+        using TankReplay::PutInt;
+        TankField* f = field;
+        out.append(magic, 4);
+        PutInt(out, seed, 4);
+        for (int i = 0; i < 3; i++)
+            PutInt(out, TankJudge::fieldBinary[i], 4);
+        for (int i = 0; i < 3; i++)
+            PutInt(out, TankJudge::waterBinary[i], 4);
+        for (int i = 0; i < 3; i++)
+            PutInt(out, TankJudge::steelBinary[i], 4);
+        PutInt(out, appliedTurns, 2);
+        PutInt(out, f->currentTurn, 2);
+        for (int y = 0; y < fieldHeight; y++)
+            for (int x = 0; x < fieldWidth; x++)
+                PutInt(out, f->gameField[y][x], 1);
+        for (int side = 0; side < sideCount; side++)
+            for (int tank = 0; tank < tankPerSide; tank++)
+                PutInt(out, f->tankAlive[side][tank], 1);
+        for (int side = 0; side < sideCount; side++)
+            PutInt(out, f->baseAlive[side], 1);
+        for (int side = 0; side < sideCount; side++)
+            for (int tank = 0; tank < tankPerSide; tank++)
+            {
+                PutInt(out, f->tankX[side][tank] + 1, 1);
+                PutInt(out, f->tankY[side][tank] + 1, 1);
+            }
+        for (int turn = 1; turn < f->currentTurn; turn++)
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    PutInt(out, f->previousActions[turn][side][tank] + 2, 1);
+    }
+
+    // 只有版本、种子和地图都与 initdata 一致，且长度与回合数相符时才恢复
+    bool Restore(const string& data, int seed)
+    {
+        using TankReplay::GetInt;
+        using TankReplay::bytesPerTurn;
+        const unsigned char* p = (const unsigned char*)data.data();
+        if (data.size() < (size_t)headerSize || memcmp(p, magic, 4) != 0 || (int)GetInt(p + 4, 4) != seed)
+            return false;
+        for (int i = 0; i < 3; i++)
+            if ((int)GetInt(p + 8 + i * 4, 4) != TankJudge::fieldBinary[i] ||
+                (int)GetInt(p + 20 + i * 4, 4) != TankJudge::waterBinary[i] ||
+                (int)GetInt(p + 32 + i * 4, 4) != TankJudge::steelBinary[i])
+                return false;
+        TankField* f = field;
+        const int historySize = sizeof(f->previousActions) / sizeof(f->previousActions[0]);
+        int applied = GetInt(p + 44, 2), turn = GetInt(p + 46, 2);
+        if (turn < 1 || turn > maxTurn + 1 || turn > historySize || applied > turn)
+            return false;
+        if (data.size() != (size_t)headerSize + stateSize + (size_t)(turn - 1) * bytesPerTurn)
+            return false;
+        p += headerSize;
+        const unsigned char* history = p + stateSize;
+        for (int i = 0; i < (turn - 1) * bytesPerTurn; i++)
+            if (history[i] > LeftShoot + 2)
+                return false;
+        appliedTurns = applied;
+        f->currentTurn = turn;
+        for (int y = 0; y < fieldHeight; y++)
+            for (int x = 0; x < fieldWidth; x++)
+                f->gameField[y][x] = (FieldItem)*p++;
+        for (int side = 0; side < sideCount; side++)
+            for (int tank = 0; tank < tankPerSide; tank++)
+                f->tankAlive[side][tank] = *p++ != 0;
+        for (int side = 0; side < sideCount; side++)
+            f->baseAlive[side] = *p++ != 0;
+        for (int side = 0; side < sideCount; side++)
+            for (int tank = 0; tank < tankPerSide; tank++)
+            {
+                f->tankX[side][tank] = *p++ - 1;
+                f->tankY[side][tank] = *p++ - 1;
+            }
+        for (int t = 1; t < turn; t++)
+            for (int side = 0; side < sideCount; side++)
+                for (int tank = 0; tank < tankPerSide; tank++)
+                    f->previousActions[t][side][tank] = (Action)(*p++ - 2);
+        return true;
+    }
+
+    bool LoadState(const char* path, int seed)
+    {
+        std::ifstream in(path, std::ios::binary);
+        string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return Restore(data, seed);
+    }
+
+    void SaveState(const char* path, int seed)
+    {
+        string data;
+        Capture(data, seed);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    }
+
+    // 处理一次裁判输入：状态有效时只执行 log 中尚未执行的回复
+    Json::Value Step(Json::Value& input, const char* statePath)
+    {
+        Json::Value output, initdata = input["initdata"], log = input["log"];
+        int size = log.size();
+        if (!field)
+        {
+            TankJudge::SetupField(initdata);
+            appliedTurns = 0;
+            if (statePath && size > 1)
+                LoadState(statePath, initdata["seed"].asInt());
+        }
+        if (size == 0)
+        {
+            TankJudge::InitialRequest(initdata, output);
+            appliedTurns = 0;
+        }
+        else
         {
-            bool isLast = size - 1 == i;
-            Json::Value response = input[i];
-            for (int side = 0; side < TankGame::sideCount; side++)//simulate each round
+            int first = 1 + 2 * appliedTurns;
+            if (first >= size)
             {
-                Json::Value raw = response[int2str[side]],
-                    answer = raw["response"].isNull() ? raw["content"] : raw["response"];
-                TankGame::Action act0, act1;
-                if (answer.isArray() && answer[0U].isInt() && answer[1U].isInt())
-                {
-                    act0 = (TankGame::Action)answer[0U].asInt();
-                    act1 = (TankGame::Action)answer[1U].asInt();
-                    if (isLast)
-                    {
-                        auto action = Json::Value(Json::arrayValue);
-                        action[0U] = act0;
-                        action[1U] = act1;
-                        output["display"][int2str[side]] = output["content"][int2str[1 - side]] = action;
-                        if (!TankGame::field->tankAlive[side][0] || !TankGame::field->ActionIsValid(side, 0, act0))
-                            output["content"][int2str[1 - side]][0U] = -1;
-                        if (!TankGame::field->tankAlive[side][1] || !TankGame::field->ActionIsValid(side, 1, act1))
-                            output["content"][int2str[1 - side]][1U] = -1;
-                    }
-                    if ((!TankGame::field->tankAlive[side][0] || TankGame::field->ActionIsValid(side, 0, act0)) &&
-                        (!TankGame::field->tankAlive[side][1] || TankGame::field->ActionIsValid(side, 1, act1)))
-                    {
-                        TankGame::field->nextAction[side][0] = act0;
-                        TankGame::field->nextAction[side][1] = act1;
-                        continue;
-                    }
-                }
-                invalid[side] = true;
-                output["display"]["loseReason"][side] = "INVALID_INPUT_VERDICT_" + raw["verdict"].asString();
+                // 保存的局面不比 log 旧（同一输入重复调用，或者不是同一局），从头重放
+                TankJudge::SetupField(initdata);
+                appliedTurns = 0;
+                first = 1;
             }
-            if (invalid[0] || invalid[1])
+            for (int i = first; i < size; i += 2)
             {
-                output["command"] = "finish";
-                if (invalid[0] == invalid[1])
-                    setWinner(-1);
-                else if (invalid[0])
-                    setWinner(1);
-                else
-                    setWinner(0);
-                break;
+                ++appliedTurns;
+                if (!TankJudge::ProcessTurn(log[i], size - 1 == i, output))
+                    break;
             }
-            else
-                TankGame::field->DoAction();
+        }
+        if (statePath)
+            SaveState(statePath, initdata["seed"].asInt());
+        return output;
+    }
+
+    // judge incremental <statefile>：每回合仍由平台重新启动，但局面从旁路文件恢复
+    int RunWithStateFile(const char* path)
+    {
+        Json::Reader reader;
+        Json::Value input;
+        if (!reader.parse(cin, input))
+            return 1;
+        Json::FastWriter writer;
+        cout << writer.write(Step(input, path));
+        return 0;
+    }
 
-            int result = TankGame::field->GetGameResult();
-            if (result != -2)
+    // judge keep-running：输出后请求平台保持进程，之后每次读入一行新的输入
+    // 新输入可以是完整的裁判输入（只执行新增的回复），也可以只是最新的一项 log
+    int RunKeepRunning()
+    {
+        Json::Reader reader;
+        Json::FastWriter writer;
+        Json::Value input, fullInput;
+        string line;
+        while (getline(cin, line))
+        {
+            if (line.empty() || !reader.parse(line, input))
+                continue;
+            if (input.isObject() && input.isMember("log"))
+                fullInput = input;
+            else
             {
-                output["command"] = "finish";
-                setWinner(result);
-                for (int side = 0; side < TankGame::sideCount; side++)
-                {
-                    bool tankExist = TankGame::field->tankAlive[side][0] || TankGame::field->tankAlive[side][1];
-                    bool baseExist = TankGame::field->baseAlive[side];
-                    if (!tankExist && !baseExist)
-                        output["display"]["loseReason"][side] = "BASE_TANK_ALL_DESTROYED";
-                    else if (!tankExist)
-                        output["display"]["loseReason"][side] = "TANK_ALL_DESTROYED";
-                    else if (!baseExist)
-                        output["display"]["loseReason"][side] = "BASE_DESTROYED";
-                }
-                break;
+                // 只有最新的一项回复：接到已知的 log 后面
+                if (fullInput.isNull())
+                    return 1;
+                fullInput["log"].append(Json::Value(Json::objectValue));
+                fullInput["log"].append(input);
             }
-            else if (isLast)
-                output["command"] = "request";
-            TankGame::field->DebugPrint();
+            Json::Value output = Step(fullInput, nullptr);
+            if (output.isMember("initdata"))
+                fullInput["initdata"] = output["initdata"];
+            cout << writer.write(output);
+            if (output["command"].asString() == "finish")
+                return 0;
+            cout << ">>>BOTZONE_REQUEST_KEEP_RUNNING<<<" << endl;
         }
+        return 0;
+    }
+}
+
+#ifndef TANKJUDGE_NO_MAIN
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+    {
+        string mode = argv[1];
+        if (mode == "replay-encode")
+            return TankReplay::Encode();
+        if (mode == "replay-decode")
+            return TankReplay::Decode(argc > 2 ? atoi(argv[2]) : 0);
+        if (mode == "replay-show" && argc > 4)
+            return TankReplay::Show(argv[2], atoi(argv[3]), atoi(argv[4]));
+        if (mode == "incremental" && argc > 2)
+            return TankIncremental::RunWithStateFile(argv[2]);
+        if (mode == "keep-running")
+            return TankIncremental::RunKeepRunning();
+        if (mode == "map-bench")
+            return TankJudge::MapBench(argc > 2 ? atoi(argv[2]) : 100000, argc > 3 ? atoi(argv[3]) : 1);
+        std::cerr << "usage: judge [replay-encode | replay-decode [game] | replay-show <file> <game> <turn> |" << endl
+                  << "              incremental <statefile> | keep-running | map-bench [count] [seed]]" << endl;
+        return 1;
     }
 
+    Json::Reader reader;
+    Json::Value input, output;
+    #ifdef _BOTZONE_ONLINE
+    reader.parse(cin, input);
+    #else
+    char *s="{\"log\":[{\"keep_running\":false,\"memory\":160,\"output\":{\"command\":\"request\",\"content\":{\"0\":{\"brickfield\":[71620266,4718352,44783889],\"waterfield\":[0,0,0],\"steelfield\":[0,0,0],\"mySide\":0},\"1\":{\"brickfield\":[71620266,4718352,44783889],\"waterfield\":[0,0,0],\"steelfield\":[0,0,0],\"mySide\":1}},\"display\":[71620266,4718352,44783889]},\"time\":3,\"verdict\":\"OK\"},{\"0\":{\"keep_running\":true,\"memory\":165,\"time\":89,\"verdict\":\"OK\",\"debug\":\"DEBUG!\",\"response\":[6,7]},\"1\":{\"keep_running\":true,\"memory\":20,\"time\":4,\"verdict\":\"OK\",\"response\":[0,4]}},{\"keep_running\":false,\"memory\":15,\"output\":{\"command\":\"request\",\"content\":{\"0\":[0,4],\"1\":[6,7]},\"display\":{\"0\":[6,7],\"1\":[0,4]}},\"time\":3,\"verdict\":\"OK\"},{\"0\":{\"keep_running\":true,\"memory\":165,\"time\":1,\"verdict\":\"OK\",\"debug\":\"DEBUG!\",\"response\":[2,-1]},\"1\":{\"keep_running\":true,\"memory\":20,\"time\":0,\"verdict\":\"OK\",\"response\":[0,0]}},{\"keep_running\":false,\"memory\":15,\"output\":{\"command\":\"request\",\"content\":{\"0\":[0,0],\"1\":[2,-1]},\"display\":{\"0\":[2,-1],\"1\":[0,0]}},\"time\":2,\"verdict\":\"OK\"},{\"0\":{\"keep_running\":true,\"memory\":165,\"time\":0,\"verdict\":\"OK\",\"debug\":\"DEBUG!\",\"response\":[0,7]},\"1\":{\"keep_running\":true,\"memory\":20,\"time\":0,\"verdict\":\"OK\",\"response\":[7,0]}}],\"initdata\":{\"brickfield\":[71620266,4718352,44783889],\"waterfield\":[0,0,0],\"steelfield\":[0,0,0],\"maxTurn\":100,\"seed\":1552650152}}";
+    reader.parse(s,input);
+
+    //test
+    {Json::FastWriter writer;
+     printf("%s\n\n",s);
+    cout << writer.write(input);}
+    #endif
+    Json::Value initdata = input["initdata"];
+    TankJudge::SetupField(initdata);
+
+    input = input["log"];
+
+    int size = input.size();
+    if (size == 0)//before 1st round
+        TankJudge::InitialRequest(initdata, output);
+    else
+        TankJudge::ProcessLog(input, 1, output);
+
     Json::FastWriter writer;
     cout << writer.write(output);
-}
\ No newline at end of file
+}
+#endif
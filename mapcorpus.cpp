@@ -0,0 +1,405 @@
+// Tank2 地图库
+// 按种子区间多线程生成合法地图，按 brick/water/steel 三元组去重，附上简单特征后
+// 按分层排序写成可以直接 mmap 的文件，供测速和自对弈按层抽样
+// 地图 i 的 seed 与裁判 initdata 的 seed 含义相同：把它交给裁判会得到同一张地图
+//
+// mapcorpus build <file> <firstSeed> <seedCount> [threads]
+// mapcorpus stats <file>
+// mapcorpus sample <file> <perStratum> [seed]   每层抽 perStratum 张，每行输出一个 initdata
+#define TANKJUDGE_NO_MAIN
+#include "judge.cpp"
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MapCorpus
+{
+    using namespace TankGame;
+    using TankJudge::MapRandom;
+
+    const char magic[4] = { 'A', 'T', 'M', '1' };
+    const uint32_t version = 1;
+
+    // 分层：砖密度 4 档 × 基地暴露度 3 档
+    const int densityBuckets = 4, exposureBuckets = 3, strataCount = densityBuckets * exposureBuckets;
+    const int densityThreshold[densityBuckets - 1] = { 34, 38, 42 };
+    const int exposureThreshold[exposureBuckets - 1] = { 4, 6 };
+    const int laneLength = 4;
+
+    struct MapRecord
+    {
+        int32_t brick[3], water[3], steel[3];
+        uint32_t seed;
+        uint8_t bricks;       // 砖块数
+        uint8_t openLanes;    // 连续空地通道数
+        uint8_t baseExposure; // 至多隔一层砖就能直射基地的空地数
+        uint8_t stratum;
+    };
+    static_assert(sizeof(MapRecord) == 44, "MapRecord 是文件格式的一部分");
+
+    struct StratumEntry
+    {
+        uint32_t offset, count;
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t count;
+        uint32_t stratumCount;
+        uint32_t firstSeed;
+        uint32_t seedCount;
+        StratumEntry strata[strataCount];
+    };
+
+    inline int CellAt(const MapRecord& r, int x, int y)
+    {
+        int c = y * fieldWidth + x, word = c / 27, mask = 1 << (c % 27);
+        return r.brick[word] & mask ? Brick : r.water[word] & mask ? Water : r.steel[word] & mask ? Steel : None;
+    }
+
+    void ComputeFeatures(MapRecord& r)
+    {
+        int bricks = 0;
+        for (int w = 0; w < 3; w++)
+            bricks += __builtin_popcount(r.brick[w]);
+        r.bricks = bricks;
+
+        // 连续至少 laneLength 格空地的横竖通道
+        int lanes = 0;
+        for (int dir = 0; dir < 2; dir++)
+            for (int i = 0; i < fieldWidth; i++)
+            {
+                int run = 0;
+                for (int j = 0; j <= fieldHeight; j++)
+                {
+                    if (j < fieldHeight && CellAt(r, dir ? i : j, dir ? j : i) == None)
+                        run++;
+                    else
+                    {
+                        lanes += run >= laneLength;
+                        run = 0;
+                    }
+                }
+            }
+        r.openLanes = lanes;
+
+        // 地图中心对称，只看一方基地
+        int exposure = 0;
+        for (int dir = 0; dir < 4; dir++)
+        {
+            int x = baseX[0] + dx[dir], y = baseY[0] + dy[dir], layers = 0;
+            for (; CoordValid(x, y); x += dx[dir], y += dy[dir])
+            {
+                int item = CellAt(r, x, y);
+                if (item == Steel || (item == Brick && ++layers > 1))
+                    break;
+                if (item == None)
+                    exposure++;
+            }
+        }
+        r.baseExposure = exposure;
+
+        int density = 0, exposed = 0;
+        while (density < densityBuckets - 1 && bricks >= densityThreshold[density])
+            density++;
+        while (exposed < exposureBuckets - 1 && exposure >= exposureThreshold[exposed])
+            exposed++;
+        r.stratum = density * exposureBuckets + exposed;
+    }
+
+    inline uint64_t HashTriple(const MapRecord& r)
+    {
+        uint64_t h = 0x243F6A8885A308D3ull;
+        for (int w = 0; w < 3; w++)
+        {
+            h = (h ^ (uint32_t)r.brick[w]) * 0x9E3779B97F4A7C15ull;
+            h = (h ^ (uint32_t)r.water[w]) * 0x9E3779B97F4A7C15ull;
+            h = (h ^ (uint32_t)r.steel[w]) * 0x9E3779B97F4A7C15ull;
+        }
+        return h ^ (h >> 29);
+    }
+
+    inline bool SameTriple(const MapRecord& a, const MapRecord& b)
+    {
+        return !memcmp(a.brick, b.brick, sizeof(a.brick)) && !memcmp(a.water, b.water, sizeof(a.water)) &&
+            !memcmp(a.steel, b.steel, sizeof(a.steel));
+    }
+
+    // 开放寻址的去重索引，只存记录下标
+    class DedupIndex
+    {
+        std::vector<uint32_t> slots;
+        uint64_t mask;
+        const std::vector<MapRecord>& records;
+    public:
+        DedupIndex(const std::vector<MapRecord>& records, size_t expected) : records(records)
+        {
+            size_t size = 16;
+            while (size < expected * 2)
+                size <<= 1;
+            slots.assign(size, UINT32_MAX);
+            mask = size - 1;
+        }
+
+        // 没见过就记下并返回 true
+        bool Insert(const MapRecord& r, uint32_t index)
+        {
+            for (uint64_t i = HashTriple(r) & mask;; i = (i + 1) & mask)
+            {
+                if (slots[i] == UINT32_MAX)
+                {
+                    slots[i] = index;
+                    return true;
+                }
+                if (SameTriple(records[slots[i]], r))
+                    return false;
+            }
+        }
+    };
+
+    // 生成 [first, first + count) 的地图，结果只与种子有关，和线程数无关
+    void GenerateRange(uint32_t first, uint32_t count, MapRecord* out)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            MapRecord& r = out[i];
+            MapRandom rng(first + i);
+            TankJudge::GenerateMap(rng, r.brick, r.water, r.steel);
+            r.seed = first + i;
+            ComputeFeatures(r);
+        }
+    }
+
+    int Build(const char* path, uint32_t firstSeed, uint32_t seedCount, int threads)
+    {
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        auto begin = std::chrono::steady_clock::now();
+
+        std::vector<MapRecord> generated(seedCount);
+        std::vector<std::thread> workers;
+        uint32_t chunk = (seedCount + threads - 1) / threads;
+        for (int t = 0; t < threads; t++)
+        {
+            uint32_t from = std::min<uint64_t>((uint64_t)t * chunk, seedCount);
+            uint32_t to = std::min<uint64_t>((uint64_t)from + chunk, seedCount);
+            if (from < to)
+                workers.emplace_back(GenerateRange, firstSeed + from, to - from, generated.data() + from);
+        }
+        for (auto& w : workers)
+            w.join();
+
+        // 按种子顺序去重，保留最小的种子
+        std::vector<MapRecord> unique;
+        unique.reserve(seedCount);
+        DedupIndex index(unique, seedCount);
+        for (auto& r : generated)
+            if (index.Insert(r, unique.size()))
+                unique.push_back(r);
+
+        // 按层稳定排序，层内仍按种子升序
+        std::stable_sort(unique.begin(), unique.end(),
+            [](const MapRecord& a, const MapRecord& b) { return a.stratum < b.stratum; });
+        Header header = {};
+        memcpy(header.magic, magic, 4);
+        header.version = version;
+        header.count = unique.size();
+        header.stratumCount = strataCount;
+        header.firstSeed = firstSeed;
+        header.seedCount = seedCount;
+        for (uint32_t i = 0; i < unique.size(); i++)
+        {
+            StratumEntry& e = header.strata[unique[i].stratum];
+            if (!e.count)
+                e.offset = i;
+            e.count++;
+        }
+
+        FILE* f = fopen(path, "wb");
+        if (!f)
+        {
+            std::cerr << "cannot open " << path << endl;
+            return 1;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(unique.data(), sizeof(MapRecord), unique.size(), f) == unique.size();
+        ok = (fclose(f) == 0) && ok;
+        if (!ok)
+        {
+            std::cerr << "write failed: " << path << endl;
+            return 1;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        cout << seedCount << " seeds, " << unique.size() << " unique maps, " << threads << " threads, "
+             << seconds << " s (" << (long long)(seedCount / seconds) << " maps/s)" << endl;
+        return 0;
+    }
+
+    // 只读打开地图库；有 mmap 就直接映射
+    class Corpus
+    {
+        const unsigned char* base = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        std::vector<unsigned char> buffer;
+#endif
+    public:
+        Corpus() = default;
+        Corpus(const Corpus&) = delete;
+        Corpus& operator=(const Corpus&) = delete;
+
+        ~Corpus()
+        {
+#ifndef _WIN32
+            if (base)
+                munmap((void*)base, size);
+#endif
+        }
+
+        bool Open(const char* path)
+        {
+#ifdef _WIN32
+            std::ifstream in(path, std::ios::binary);
+            buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            base = buffer.data();
+            size = buffer.size();
+#else
+            int fd = open(path, O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                size = st.st_size;
+                void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                base = p == MAP_FAILED ? nullptr : (const unsigned char*)p;
+            }
+            close(fd);
+            if (!base)
+                return false;
+#endif
+            if (!base || size < sizeof(Header))
+                return false;
+            const Header& h = GetHeader();
+            if (memcmp(h.magic, magic, 4) || h.version != version || h.stratumCount != (uint32_t)strataCount ||
+                size < sizeof(Header) + (size_t)h.count * sizeof(MapRecord))
+                return false;
+            // 每一层都要落在记录范围内，否则截断或损坏的文件会让 StratumMap 读出映射之外
+            for (int i = 0; i < strataCount; i++)
+                if ((uint64_t)h.strata[i].offset + h.strata[i].count > h.count)
+                    return false;
+            return true;
+        }
+
+        const Header& GetHeader() const
+        {
+            return *(const Header*)base;
+        }
+
+        uint32_t Count() const
+        {
+            return GetHeader().count;
+        }
+
+        const MapRecord& Map(uint32_t i) const
+        {
+            return ((const MapRecord*)(base + sizeof(Header)))[i];
+        }
+
+        uint32_t StratumSize(int stratum) const
+        {
+            return GetHeader().strata[stratum].count;
+        }
+
+        const MapRecord& StratumMap(int stratum, uint32_t i) const
+        {
+            return Map(GetHeader().strata[stratum].offset + i);
+        }
+
+        // 从某一层均匀抽一张，该层为空时返回 nullptr
+        const MapRecord* Sample(int stratum, MapRandom& rng) const
+        {
+            uint32_t n = StratumSize(stratum);
+            return n ? &StratumMap(stratum, rng.Below(n)) : nullptr;
+        }
+    };
+
+    void PrintInitdata(const MapRecord& r)
+    {
+        printf("{\"seed\":%u,\"brickfield\":[%d,%d,%d],\"waterfield\":[%d,%d,%d],\"steelfield\":[%d,%d,%d]}\n",
+            r.seed, r.brick[0], r.brick[1], r.brick[2], r.water[0], r.water[1], r.water[2],
+            r.steel[0], r.steel[1], r.steel[2]);
+    }
+
+    int Stats(const char* path)
+    {
+        Corpus corpus;
+        if (!corpus.Open(path))
+        {
+            std::cerr << "bad corpus file: " << path << endl;
+            return 1;
+        }
+        const Header& h = corpus.GetHeader();
+        cout << h.count << " maps from seeds [" << h.firstSeed << ", " << (uint64_t)h.firstSeed + h.seedCount << ")" << endl;
+        for (int s = 0; s < strataCount; s++)
+        {
+            double bricks = 0, lanes = 0, exposure = 0;
+            uint32_t n = corpus.StratumSize(s);
+            for (uint32_t i = 0; i < n; i++)
+            {
+                const MapRecord& r = corpus.StratumMap(s, i);
+                bricks += r.bricks;
+                lanes += r.openLanes;
+                exposure += r.baseExposure;
+            }
+            printf("stratum %2d (density %d, exposure %d): %9u maps", s, s / exposureBuckets, s % exposureBuckets, n);
+            if (n)
+                printf("  bricks %.1f  lanes %.2f  exposure %.2f", bricks / n, lanes / n, exposure / n);
+            printf("\n");
+        }
+        return 0;
+    }
+
+    int Sample(const char* path, int perStratum, unsigned seed)
+    {
+        Corpus corpus;
+        if (!corpus.Open(path))
+        {
+            std::cerr << "bad corpus file: " << path << endl;
+            return 1;
+        }
+        MapRandom rng(seed);
+        for (int s = 0; s < strataCount; s++)
+            for (int i = 0; i < perStratum; i++)
+                if (const MapRecord* r = corpus.Sample(s, rng))
+                    PrintInitdata(*r);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "build" && argc > 4)
+        return MapCorpus::Build(argv[2], strtoul(argv[3], nullptr, 10), strtoul(argv[4], nullptr, 10),
+            argc > 5 ? atoi(argv[5]) : 0);
+    if (mode == "stats" && argc > 2)
+        return MapCorpus::Stats(argv[2]);
+    if (mode == "sample" && argc > 3)
+        return MapCorpus::Sample(argv[2], atoi(argv[3]), argc > 4 ? strtoul(argv[4], nullptr, 10) : 1);
+    std::cerr << "usage: mapcorpus build <file> <firstSeed> <seedCount> [threads] | stats <file> |" << endl
+              << "                 sample <file> <perStratum> [seed]" << endl;
+    return 1;
+}
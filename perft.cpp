@@ -0,0 +1,225 @@
+// 走法生成和 DoAction/Revert 的 perft 校验与测速
+// 从标准输入读取 Botzone 格式的局面（与 Bot 的输入相同），枚举之后 depth 回合内
+// 双方所有合法的联合动作（死亡的坦克只能 Stay，不能连续两回合射击），统计叶子数和终局结果
+//
+// perft <depth> [threads] [hashMB]    hashMB 为 0 时不用置换表，可用来核对置换表的结果
+#define ALPHATANK_NO_MAIN
+#include "alphatank.cpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Perft {
+    using namespace TankGame;
+
+    struct Counts {
+        unsigned long long nodes = 0;       // 第 depth 回合仍未结束的局面数（路径数）
+        unsigned long long outcome[3] = {}; // 途中结束的路径：平局、蓝胜、红胜（下标为 GameResult + 1）
+
+        Counts &operator+=(const Counts &b) {
+            nodes += b.nodes;
+            for (int i = 0; i < 3; i++)
+                outcome[i] += b.outcome[i];
+            return *this;
+        }
+    };
+
+    // 置换表：按 (局面哈希, 回合, 剩余深度) 保存子树的统计，分段加锁，多线程共享
+    // Hash() 不含回合数，而离平局的回合数会影响统计，所以回合要单独比较
+    // 每个桶两项：不浅于第一项的子树放进第一项，原来的第一项挪到第二项；更浅的只替换第二项
+    // 深的子树省下的节点多，不会被大量的浅层结果挤掉，深度相同时两项按先后淘汰
+    class TranspositionTable {
+        struct Entry {
+            unsigned long long key = 0;
+            int turn = 0, depth = -1;
+            Counts counts;
+        };
+
+        static const int stripeCount = 1024;
+        vector<Entry> entries;
+        size_t mask = 0;
+        std::mutex stripes[stripeCount];
+        std::atomic<unsigned long long> probes{0}, hits{0};
+
+    public:
+        explicit TranspositionTable(size_t megabytes) {
+            size_t size = 1;
+            while ((size * 2) * 2 * sizeof(Entry) <= megabytes << 20)
+                size <<= 1;
+            if (megabytes)
+                entries.resize(size * 2);
+            mask = size - 1;
+        }
+
+        bool Enabled() const {
+            return !entries.empty();
+        }
+
+        bool Probe(unsigned long long key, int turn, int depth, Counts &out) {
+            size_t i = key & mask;
+            probes.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(stripes[i % stripeCount]);
+            for (size_t j = i * 2; j < i * 2 + 2; j++)
+                if (entries[j].key == key && entries[j].turn == turn && entries[j].depth == depth) {
+                    out = entries[j].counts;
+                    hits.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            return false;
+        }
+
+        void Store(unsigned long long key, int turn, int depth, const Counts &counts) {
+            size_t i = key & mask;
+            std::lock_guard<std::mutex> lock(stripes[i % stripeCount]);
+            Entry &first = entries[i * 2], &e = depth >= first.depth ? first : entries[i * 2 + 1];
+            if (&e == &first)
+                entries[i * 2 + 1] = first;
+            e.key = key;
+            e.turn = turn;
+            e.depth = depth;
+            e.counts = counts;
+        }
+
+        // 上次 ResetStats 以来 Probe 命中的比例
+        double HitRate() const {
+            return probes ? (double) hits / probes : 0.0;
+        }
+
+        void ResetStats() {
+            probes = hits = 0;
+        }
+    };
+
+    // 一个坦克的全部合法动作，按 Stay 到 LeftShoot 的顺序展开 LegalActions 的掩码
+    int LegalActions(TankField &f, int side, int tank, Action out[]) {
+        unsigned legal = f.LegalActions(side, tank);
+        int n = 0;
+        for (int act = Stay; act <= LeftShoot; act++)
+            if (legal & ActionBit((Action) act))
+                out[n++] = (Action) act;
+        return n;
+    }
+
+    // 枚举所有坦克的联合动作，对每个组合调用 visit
+    template<typename Visit>
+    void ForEachJointAction(TankField &f, Visit &&visit) {
+        const int tanks = sideCount * tankPerSide;
+        Action legal[tanks][9];
+        int count[tanks], index[tanks] = {};
+        for (int i = 0; i < tanks; i++)
+            count[i] = LegalActions(f, i / tankPerSide, i % tankPerSide, legal[i]);
+        while (true) {
+            Action joint[tanks];
+            for (int i = 0; i < tanks; i++)
+                joint[i] = legal[i][index[i]];
+            visit(joint);
+            int i = 0;
+            while (i < tanks && ++index[i] == count[i])
+                index[i++] = 0;
+            if (i == tanks)
+                break;
+        }
+    }
+
+    bool Apply(TankField &f, const Action joint[]) {
+        for (int side = 0; side < sideCount; side++)
+            for (int tank = 0; tank < tankPerSide; tank++)
+                f.nextAction[side][tank] = joint[side * tankPerSide + tank];
+        return f.DoAction();
+    }
+
+    Counts Search(TankField &f, int depth, TranspositionTable &tt) {
+        Counts counts;
+        GameResult result = f.GetGameResult();
+        if (result != NotFinished) {
+            counts.outcome[result + 1] = 1;
+            return counts;
+        }
+        if (depth == 0) {
+            counts.nodes = 1;
+            return counts;
+        }
+        unsigned long long key = 0;
+        if (tt.Enabled() && depth > 1) {
+            key = f.Hash();
+            if (tt.Probe(key, f.currentTurn, depth, counts))
+                return counts;
+        }
+        ForEachJointAction(f, [&](const Action joint[]) {
+            if (!Apply(f, joint)) {
+                std::cerr << "legal action rejected by DoAction at turn " << (int) f.currentTurn << endl;
+                exit(1);
+            }
+            counts += Search(f, depth - 1, tt);
+            f.Revert();
+        });
+        if (tt.Enabled() && depth > 1)
+            tt.Store(key, f.currentTurn, depth, counts);
+        return counts;
+    }
+
+    // 根节点的联合动作分给各线程，每个线程持有一份局面副本
+    Counts Run(TankField &root, int depth, int threads, TranspositionTable &tt) {
+        if (depth == 0 || root.GetGameResult() != NotFinished)
+            return Search(root, depth, tt);
+        vector<vector<Action>> moves;
+        ForEachJointAction(root, [&](const Action joint[]) {
+            moves.emplace_back(joint, joint + sideCount * tankPerSide);
+        });
+        std::atomic<size_t> next(0);
+        vector<Counts> partial(threads);
+        vector<std::thread> workers;
+        for (int t = 0; t < threads; t++)
+            workers.emplace_back([&, t]() {
+                std::unique_ptr<TankField> f(new TankField(root));
+                for (size_t i; (i = next++) < moves.size();) {
+                    Apply(*f, moves[i].data());
+                    partial[t] += Search(*f, depth - 1, tt);
+                    f->Revert();
+                }
+            });
+        Counts total;
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+            total += partial[t];
+        }
+        return total;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: perft <depth> [threads] [hashMB] < botinput.json" << endl;
+        return 1;
+    }
+    int depth = atoi(argv[1]);
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t hashMB = argc > 3 ? strtoul(argv[3], nullptr, 10) : 64;
+
+    string data, globaldata;
+    TankGame::ReadInput(cin, data, globaldata);
+    if (!TankGame::field) {
+        std::cerr << "no field in input" << endl;
+        return 1;
+    }
+    Perft::TranspositionTable tt(hashMB);
+    printf("turn %d, %d threads, hash %zu MB\n", TankGame::field->currentTurn, threads, hashMB);
+    printf("%5s %16s %12s %12s %12s %10s %14s %8s\n", "depth", "nodes", "draw", "blue", "red", "seconds", "nodes/s",
+           "tt hit");
+    for (int d = 1; d <= depth; d++) {
+        tt.ResetStats();
+        auto begin = std::chrono::steady_clock::now();
+        Perft::Counts c = Perft::Run(*TankGame::field, d, threads, tt);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        printf("%5d %16llu %12llu %12llu %12llu %10.3f %14.0f %7.1f%%\n", d, c.nodes, c.outcome[0], c.outcome[1],
+               c.outcome[2], seconds, seconds > 0 ? c.nodes / seconds : 0.0, 100 * tt.HitRate());
+        fflush(stdout);
+    }
+    return 0;
+}